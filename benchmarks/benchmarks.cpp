@@ -0,0 +1,479 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>  // for sort(), upper_bound()
+#include <array>
+#include <cmath>  // for sqrt()
+#include <memory>  // for unique_ptr
+#include <optional>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "asdfspline.hpp"
+#include "asdfsplinebuilder.hpp"
+#include "centripetalkochanekbartelsspline.hpp"
+#include "gridsearch.hpp"
+#include "soacubiccurve.hpp"
+#include "vec3.hpp"
+
+using V = Vec3<float>;
+using Spline = asdf::AsdfSpline<float, V>;
+using Vertex = Spline::AsdfVertex;
+
+template<typename S, typename V>
+struct asdf::AsdfSplineInternals
+{
+  static S s2u(const AsdfSpline<S, V>& spline, S s)
+  {
+    typename AsdfSpline<S, V>::_Hint hint;
+    return spline._s2u(s, hint);
+  }
+
+  static const auto& t2s(const AsdfSpline<S, V>& spline)
+  {
+    return spline._t2s;
+  }
+
+  static const auto& path(const AsdfSpline<S, V>& spline)
+  {
+    return spline._path;
+  }
+};
+
+using Internals = asdf::AsdfSplineInternals<float, V>;
+
+namespace {
+
+/// Random walk with n vertices.
+/// If "timed", every third vertex has a time and every sixth a speed,
+/// otherwise only the last vertex has a time (i.e. constant speed).
+/// Times are chosen such that the speed is roughly 1 everywhere
+/// (because the arc length is a bit larger than the straight distance),
+/// otherwise given speeds might not be possible.
+std::vector<Vertex> random_vertices(size_t n, bool closed, bool timed)
+{
+  std::mt19937 rng(1);
+  std::normal_distribution<float> step(0, 1);
+  std::vector<Vertex> result;
+  V position{};
+  double time = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    V delta{step(rng), step(rng), step(rng)};
+    position += delta;
+    if (i > 0)
+    {
+      time += double(length(delta));
+    }
+    Vertex vertex{position, {}, {}, {}};
+    if ((timed && i % 3 == 0) || i == n - 1)
+    {
+      vertex.time = float(time);
+    }
+    if (timed && i % 6 == 0 && 0 < i && i < n - 1)
+    {
+      vertex.speed = 1;
+    }
+    result.push_back(vertex);
+  }
+  if (closed)
+  {
+    result.back().position = asdf::CLOSED{};
+  }
+  return result;
+}
+
+/// Arguments: number of vertices, closed, timed
+std::tuple<size_t, bool, bool> parameters(const benchmark::State& state)
+{
+  return {static_cast<size_t>(state.range(0))
+    , state.range(1) != 0, state.range(2) != 0};
+}
+
+/// The most recently used spline is kept, because construction
+/// of the large ones takes much longer than the benchmarks themselves
+const Spline& cached_spline(const benchmark::State& state)
+{
+  static std::tuple<size_t, bool, bool> key;
+  static std::unique_ptr<Spline> spline;
+  if (!spline || key != parameters(state))
+  {
+    spline.reset();  // Free memory before creating the next one
+    key = parameters(state);
+    auto [n, closed, timed] = key;
+    spline = std::make_unique<Spline>(random_vertices(n, closed, timed));
+  }
+  return *spline;
+}
+
+/// Uniformly distributed random values in [min, max)
+std::vector<float> random_values(float min, float max, size_t n = 4096)
+{
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> dist(min, max);
+  std::vector<float> result(n);
+  for (auto& value: result)
+  {
+    value = dist(rng);
+  }
+  return result;
+}
+
+void arguments(benchmark::internal::Benchmark* b)
+{
+  b->ArgNames({"vertices", "closed", "timed"});
+  for (int64_t n = 10; n <= 1000000; n *= 10)
+  {
+    for (int64_t closed: {0, 1})
+    {
+      for (int64_t timed: {0, 1})
+      {
+        b->Args({n, closed, timed});
+      }
+    }
+  }
+}
+
+void BM_Construction(benchmark::State& state)
+{
+  auto [n, closed, timed] = parameters(state);
+  auto data = random_vertices(n, closed, timed);
+  for (auto _: state)
+  {
+    Spline spline(data);
+    benchmark::DoNotOptimize(spline);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Construction)->Apply(arguments)->Unit(benchmark::kMillisecond);
+
+void BM_Evaluate(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto times = random_values(spline.grid().front(), spline.grid().back());
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(spline.evaluate(times[i++ % times.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Evaluate)->Apply(arguments);
+
+void BM_EvaluateVelocity(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto times = random_values(spline.grid().front(), spline.grid().back());
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(
+        spline.evaluate_velocity(times[i++ % times.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EvaluateVelocity)->Apply(arguments);
+
+/// Separate calls, for comparison with BM_EvaluateState
+void BM_EvaluateBoth(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto times = random_values(spline.grid().front(), spline.grid().back());
+  size_t i = 0;
+  for (auto _: state)
+  {
+    auto t = times[i++ % times.size()];
+    benchmark::DoNotOptimize(spline.evaluate(t));
+    benchmark::DoNotOptimize(spline.evaluate_velocity(t));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EvaluateBoth)->Apply(arguments);
+
+void BM_EvaluateState(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto times = random_values(spline.grid().front(), spline.grid().back());
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(spline.evaluate_state(times[i++ % times.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EvaluateState)->Apply(arguments);
+
+/// Random points near the curve
+std::vector<V> random_points(const Spline& spline, size_t n = 4096)
+{
+  std::vector<V> result;
+  result.reserve(n);
+  auto times = random_values(spline.grid().front(), spline.grid().back(), n);
+  std::mt19937 rng(3);
+  std::normal_distribution<float> offset(0, 1);
+  for (auto t: times)
+  {
+    result.push_back(
+        spline.evaluate(t) + V{offset(rng), offset(rng), offset(rng)});
+  }
+  return result;
+}
+
+void BM_ClosestPoint(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto points = random_points(spline);
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(
+        spline.closest_point(points[i++ % points.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ClosestPoint)->Apply(arguments);
+
+void BM_TimeIntervalsWithin(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto points = random_points(spline);
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(
+        spline.time_intervals_within(points[i++ % points.size()], 2));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimeIntervalsWithin)->Apply(arguments);
+
+void BM_S2U(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  const auto& path = Internals::path(spline);
+  auto lengths = random_values(0
+      , path.cumulative_length(path.grid().size() - 1));
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(
+        Internals::s2u(spline, lengths[i++ % lengths.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_S2U)->Apply(arguments);
+
+/// Sorted arc lengths with a spacing of 1 cm (for a random walk with
+/// steps of 1 m).  They start at the beginning, because further along
+/// a long spline, the resolution of float would be too low.
+std::vector<float> sorted_lengths(const Spline& spline, size_t n = 4096)
+{
+  std::vector<float> result(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    result[i] = std::min(float(i) * 0.01f, spline.total_length());
+  }
+  return result;
+}
+
+/// Separate arc length inversions, for comparison with
+/// BM_EvaluateAtDistance
+void BM_S2USorted(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  const auto& path = Internals::path(spline);
+  auto lengths = sorted_lengths(spline);
+  std::vector<V> positions(lengths.size());
+  for (auto _: state)
+  {
+    for (size_t i = 0; i < lengths.size(); ++i)
+    {
+      positions[i] = path.evaluate(Internals::s2u(spline, lengths[i]));
+    }
+    benchmark::DoNotOptimize(positions.data());
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(lengths.size()));
+}
+BENCHMARK(BM_S2USorted)->Apply(arguments);
+
+void BM_EvaluateAtDistance(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  auto lengths = sorted_lengths(spline);
+  std::vector<V> positions(lengths.size());
+  for (auto _: state)
+  {
+    spline.evaluate_at_distance(
+        lengths.begin(), lengths.end(), positions.begin());
+    benchmark::DoNotOptimize(positions.data());
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(lengths.size()));
+}
+BENCHMARK(BM_EvaluateAtDistance)->Apply(arguments);
+
+void BM_GetTime(benchmark::State& state)
+{
+  const auto& spline = cached_spline(state);
+  const auto& t2s = Internals::t2s(spline);
+  const auto& path = Internals::path(spline);
+  auto lengths = random_values(0
+      , path.cumulative_length(path.grid().size() - 1));
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(t2s.get_time(lengths[i++ % lengths.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetTime)->Apply(arguments);
+
+void BM_SegmentLength(benchmark::State& state)
+{
+  const auto& path = Internals::path(cached_spline(state));
+  auto segments = path.grid().size() - 1;
+  size_t i = 0;
+  for (auto _: state)
+  {
+    benchmark::DoNotOptimize(path.segment_length(i++ % segments));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SegmentLength)->Apply(arguments);
+
+/// Streaming construction of a spline with n vertices (one at a time),
+/// without and with a window of 100 time units (about 100 vertices).
+/// The time per vertex should not depend on n.
+void BM_AppendVertex(benchmark::State& state)
+{
+  auto data = random_vertices(static_cast<size_t>(state.range(0)), false
+      , true);
+  std::optional<float> window;
+  if (state.range(1))
+  {
+    window = 100.0f;
+  }
+  // Appended vertices need a time
+  double time = 0;
+  for (size_t i = 1; i < data.size(); ++i)
+  {
+    time += double(length(std::get<V>(data[i].position)
+          - std::get<V>(data[i - 1].position)));
+    data[i].time = float(time);
+  }
+  for (auto _: state)
+  {
+    asdf::AsdfSplineBuilder<float, V> builder(window);
+    for (const auto& vertex: data)
+    {
+      builder.append_vertex(std::get<V>(vertex.position), *vertex.time
+          , vertex.speed);
+    }
+    benchmark::DoNotOptimize(builder.spline());
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(data.size()));
+}
+BENCHMARK(BM_AppendVertex)
+  ->ArgNames({"vertices", "window"})
+  ->ArgsProduct({{1000, 100000}, {0, 1}})
+  ->Unit(benchmark::kMillisecond);
+
+/// Batch evaluation of positions of a curve with n vertices, with
+/// PiecewiseCubicCurve::evaluate_many() (level:-1) or with SoaCubicCurve
+/// with the given SimdLevel (0: scalar, 1: SSE, 2: AVX2), for random
+/// (values:0) or sorted (values:1) parameter values, or sorted values
+/// with about 100 values per segment (values:2).
+void BM_EvaluateManySoa(benchmark::State& state)
+{
+  auto level = state.range(1);
+  if (level > int64_t(asdf::supported_simd_level()))
+  {
+    state.SkipWithError("SIMD level not supported");
+    return;
+  }
+  auto data = random_vertices(static_cast<size_t>(state.range(0)), false
+      , false);
+  std::vector<V> vertices;
+  for (const auto& vertex: data)
+  {
+    vertices.push_back(std::get<V>(vertex.position));
+  }
+  asdf::CentripetalKochanekBartelsSpline<float, V> curve(vertices
+      , std::vector<std::array<float, 3>>(vertices.size() - 2), false);
+  asdf::SoaCubicCurve<float, 3> soa(curve
+      , [](const V& v, size_t d) { return (&v.x)[d]; });
+  const auto& grid = curve.grid();
+  auto values = random_values(grid.front()
+      , (state.range(2) == 2) ? grid[40] : grid.back());
+  if (state.range(2))
+  {
+    std::sort(values.begin(), values.end());
+  }
+  std::vector<V> result(values.size());
+  std::array<std::vector<float>, 3> components;
+  for (auto& component: components)
+  {
+    component.resize(values.size());
+  }
+  for (auto _: state)
+  {
+    if (level < 0)
+    {
+      curve.evaluate_many(values.begin(), values.end(), result.begin());
+      benchmark::DoNotOptimize(result.data());
+    }
+    else
+    {
+      soa.evaluate_many(values.data(), values.size(), {components[0].data()
+          , components[1].data(), components[2].data()}
+          , asdf::SimdLevel(level));
+      benchmark::DoNotOptimize(components[0].data());
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(values.size()));
+}
+BENCHMARK(BM_EvaluateManySoa)
+  ->ArgNames({"vertices", "level", "values"})
+  ->ArgsProduct({{1000, 100000}, {-1, 0, 1, 2}, {0, 1, 2}});
+
+/// Random-access segment search with binary search (indexed:0),
+/// as it was done before GridIndex was introduced, or with GridIndex
+/// (indexed:1).  The grid is non-uniform, similar to the one of a
+/// centripetal spline.
+void BM_FindSegment(benchmark::State& state)
+{
+  auto segments = static_cast<size_t>(state.range(0));
+  bool indexed = state.range(1) != 0;
+  std::mt19937 rng(1);
+  std::exponential_distribution<float> step(1);
+  std::vector<float> grid{0};
+  for (size_t i = 0; i < segments; ++i)
+  {
+    grid.push_back(grid.back() + std::sqrt(step(rng) + 0.1f));
+  }
+  asdf::GridIndex<float> index;
+  index.build(grid);
+  auto values = random_values(grid.front(), grid.back());
+  size_t i = 0;
+  for (auto _: state)
+  {
+    auto value = values[i++ % values.size()];
+    if (indexed)
+    {
+      benchmark::DoNotOptimize(index.find(grid, value));
+    }
+    else
+    {
+      benchmark::DoNotOptimize(
+          std::upper_bound(grid.begin(), grid.end(), value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FindSegment)
+  ->ArgNames({"segments", "indexed"})
+  ->ArgsProduct({{1000, 100000, 1000000}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
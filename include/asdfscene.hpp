@@ -0,0 +1,120 @@
+#pragma once
+
+#include <utility>  // for forward()
+#include <vector>
+
+#include "asdfspline.hpp"
+#include "instrumentation.hpp"
+#include "workerpool.hpp"
+
+namespace asdf {
+
+/// Collection of independent AsdfSpline objects (e.g. one per sound
+/// source) which are evaluated at a common time.
+///
+/// Like in SplineCursor, segment indices and the previous arc length
+/// solution are kept for each spline from one call to the next.
+/// Therefore, evaluating at slowly advancing times (e.g. once per audio
+/// block) is much faster than calling AsdfSpline::evaluate().
+template<typename S, typename V>
+class AsdfScene
+{
+public:
+  /// "threads" is the total number of threads used by evaluate_all()
+  /// (including the calling thread).
+  explicit AsdfScene(size_t threads = 1)
+  : _pool(threads)
+  {}
+
+  /// Add a spline, all arguments are forwarded to the AsdfSpline
+  /// constructor (or an existing AsdfSpline can be moved in).
+  /// Returns the index of the new spline.
+  template<typename... Args>
+  size_t add(Args&&... args)
+  {
+    // Allocate first, so that the sizes can't get out of sync
+    _states.reserve(_states.size() + 1);
+    _splines.emplace_back(std::forward<Args>(args)...);
+    _states.push_back({{}, _splines.back()._revision});
+    return _splines.size() - 1;
+  }
+
+  size_t size() const { return _splines.size(); }
+
+  const AsdfSpline<S, V>& operator[](size_t i) const { return _splines[i]; }
+
+  /// Non-const access, e.g. for AsdfSpline::update_vertex().
+  AsdfSpline<S, V>& operator[](size_t i) { return _splines[i]; }
+
+  /// Evaluate the positions of all splines at time t and write them to
+  /// positions[0] to positions[size() - 1].
+  ///
+  /// With a single thread, this is real-time safe like
+  /// AsdfSpline::evaluate().  With multiple threads it is not: waking
+  /// the workers locks a mutex, and the calling thread has to wait until
+  /// the other threads have finished their chunks, which can be delayed
+  /// by the OS scheduler (see WorkerPool::parallel_for()).
+  template<typename RandomIt>
+  void evaluate_all(S t, RandomIt positions)
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::scene_evaluate_all);
+    _pool.parallel_for(_splines.size(), _chunk_size
+        , [this, t, positions](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        positions[i] = _splines[i]._evaluate(t, _hint(i));
+      }
+    });
+  }
+
+  /// Same as above, but velocities are evaluated as well.
+  /// This re-uses the arc length solution of each position.
+  /// Real-time safety is the same as above.
+  template<typename RandomIt1, typename RandomIt2>
+  void evaluate_all(S t, RandomIt1 positions, RandomIt2 velocities)
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::scene_evaluate_all);
+    _pool.parallel_for(_splines.size(), _chunk_size
+        , [this, t, positions, velocities](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        auto& hint = _hint(i);
+        positions[i] = _splines[i]._evaluate(t, hint);
+        velocities[i] = _splines[i]._evaluate_velocity(t, hint);
+      }
+    });
+  }
+
+private:
+  struct _State
+  {
+    typename AsdfSpline<S, V>::_Hint hint;
+    /// See AsdfSpline::_revision
+    size_t revision;
+  };
+
+  /// Search state of spline i, which is reset if the spline was modified
+  typename AsdfSpline<S, V>::_Hint& _hint(size_t i)
+  {
+    auto& state = _states[i];
+    if (state.revision != _splines[i]._revision)
+    {
+      state.hint = {};
+      state.revision = _splines[i]._revision;
+    }
+    return state.hint;
+  }
+
+  /// Number of splines that are evaluated in one go by a thread.
+  /// Neighboring states are modified in the same thread, which reduces
+  /// false sharing.
+  static constexpr size_t _chunk_size = 8;
+
+  std::vector<AsdfSpline<S, V>> _splines;
+  std::vector<_State> _states;
+  WorkerPool _pool;
+};
+
+}  // namespace asdf
@@ -1,11 +1,26 @@
 #pragma once
 
 #include <variant>
+#include <algorithm>  // for count(), count_if(), reverse()
+#include <atomic>
 #include <memory>  // for unique_ptr
+#include <memory_resource>
+#include <optional>
+#include <cmath>  // for abs(), ceil(), floor(), sqrt()
+#include <cstdint>
+#include <limits>  // for numeric_limits
+#include <stdexcept>  // for runtime_error, out_of_range
+#include <utility>  // for exchange(), pair
+#include <vector>
 
-#include "bisect.hpp"
+#include "binaryformat.hpp"
+#include "boundingspheretree.hpp"
+#include "gridsearch.hpp"
+#include "instrumentation.hpp"
+#include "newton.hpp"
 #include "centripetalkochanekbartelsspline.hpp"
 #include "monotonecubicspline.hpp"
+#include "workerpool.hpp"
 
 /// Main ASDF namespace
 namespace asdf {
@@ -13,6 +28,20 @@ namespace asdf {
 /// Dummy type to mark the last vertex in a closed curve
 struct CLOSED {};
 
+template<typename S, typename V> class SplineCursor;
+template<typename S, typename V> class AsdfScene;
+/// Access to internals, only defined in benchmarks
+template<typename S, typename V> struct AsdfSplineInternals;
+
+/// Real-time safety: evaluate() and evaluate_velocity() (as well as
+/// SplineCursor) don't allocate memory, don't lock and don't throw.
+/// The worst case is bounded: besides two binary searches, each evaluation
+/// needs at most _s2u_max_iterations steps of Newton's method (each with
+/// a low-order quadrature), or none at all if s2u tables are used.
+/// Splines can be replaced without blocking the reading thread with
+/// a SplineHandle.
+///
+/// NB: All other member functions (including construction) may allocate.
 template<typename S, typename V>
 class AsdfSpline
 {
@@ -26,30 +55,987 @@ public:
     std::array<S, 3> tcb{};
   };
 
-  /// Container of AsdfVertex elements
+  /// Result of evaluate_state()
+  struct State
+  {
+    V position;
+    V velocity;
+    V acceleration;
+    /// Length of the velocity (or 0 where the tangent is undefined)
+    S speed;
+    /// Arc length from the beginning of the spline
+    S arc_length;
+  };
+
+  /// Result of closest_point()
+  struct ClosestPoint
+  {
+    V position;
+    S distance;
+    /// Time at which the spline passes the closest point
+    S time;
+    /// Arc length from the beginning of the spline
+    S arc_length;
+  };
+
+  /// Container of AsdfVertex elements.
+  ///
+  /// If "s2u_knots" is non-zero, a table for the inversion of the
+  /// arc length is created, starting with the given number of intervals
+  /// per segment (which are subdivided where necessary).
+  /// This makes construction slower but evaluation much faster.
+  ///
+  /// "threads" is the total number of threads used for construction
+  /// (including the calling thread), which is only worthwhile for very
+  /// many vertices (or with s2u tables).  The work for individual
+  /// vertices and segments (most notably the arc length quadrature) is
+  /// distributed, cumulative sums are computed sequentially.  Therefore,
+  /// the result is the same for any number of threads.
+  ///
+  /// All memory (including temporary vectors) is allocated from
+  /// "resource" and each vector is allocated only once (except within
+  /// s2u tables, which grow while they are refined).  With a
+  /// std::pmr::monotonic_buffer_resource, many splines can be created
+  /// with very few actual allocations.  The resource must outlive the
+  /// spline, copies of the spline use the default resource.
+  /// It doesn't have to be thread-safe: with multiple threads, s2u tables
+  /// are refined in a temporary std::pmr::synchronized_pool_resource
+  /// (on top of "resource") and copied by the calling thread.
+  ///
+  /// NB: A monotonic resource never re-uses memory, each call to
+  ///     update_vertex(), update_time(), update_tcb() and append_vertex()
+  ///     makes it grow.
   template<typename C>
-  AsdfSpline(const C& data)
-  : _init(new Initializer(data))
-  , _path(_init->vertices, _init->tcb, _init->closed)
-  , _t2s(std::make_from_tuple<MonotoneCubicSpline<S>>(
-        _init->get_t2s_arguments(_path)))
-  , _grid(_init->get_grid(_t2s))
-  {
-    _init.reset();  // Initializer is not needed anymore
+  AsdfSpline(const C& data, size_t s2u_knots = 0, size_t threads = 1
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : AsdfSpline(Initializer(data, threads, resource), s2u_knots)
+  {}
+
+  /// Restore a spline that has been stored with save().
+  ///
+  /// Arc lengths, the time-to-length mapping and s2u tables are not
+  /// re-computed, but all stored values are copied into vectors allocated
+  /// from "resource", and the cheap per-segment values, search indices
+  /// and the bounding sphere tree are re-built.  The reader can be
+  /// created for a memory-mapped file (to avoid reading the whole file
+  /// into memory first), but the spline can't be evaluated directly from
+  /// the mapped memory.
+  ///
+  /// The data is validated, std::runtime_error is thrown if it is invalid.
+  explicit AsdfSpline(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _path(_read_header(reader), resource)
+  , _times(resource)
+  , _speeds(resource)
+  , _t2s(reader, resource)
+  , _grid(resource)
+  , _s_grid(resource)
+  , _s2u_tables(resource)
+  , _s_grid_index(resource)
+  , _bounds(resource)
+  {
+    reader.read(_times);
+    reader.read(_speeds);
+    reader.read(_grid);
+    reader.read(_s_grid);
+    _s2u_intervals = static_cast<size_t>(reader.template read<std::uint64_t>());
+    auto tables = reader.template read<std::uint64_t>();
+    auto segments = _path.grid().size() - 1;
+    if (_times.size() != _path.grid().size()
+        || _speeds.size() != _times.size()
+        || _grid.size() != _times.size()
+        || _s_grid.size() != _times.size()
+        || tables != (_s2u_intervals ? segments : 0)
+        || !_valid_grids())
+    {
+      throw std::runtime_error("Invalid binary data for ASDF spline");
+    }
+    _s_grid_index.build(_s_grid);
+    _bounds.build(_path.segments());
+    _s2u_tables.reserve(segments);
+    for (size_t index = 0; index < tables; ++index)
+    {
+      _s2u_tables.emplace_back(reader, resource);
+    }
+  }
+
+  /// Store the fully built spline (path with pre-computed arc lengths,
+  /// time-to-length mapping and s2u tables, if any), see BinaryFormat.
+  ///
+  /// The data starts with a header containing a format version
+  /// as well as the sizes of S and V.
+  void save(BinaryWriter<S>& writer) const
+  {
+    writer.write(_format_magic);
+    writer.write(_format_version);
+    writer.write(std::uint8_t(sizeof(S)));
+    writer.write(std::uint8_t(sizeof(V) / sizeof(S)));
+    _path.save(writer);
+    _t2s.save(writer);
+    writer.write(_times);
+    writer.write(_speeds);
+    writer.write(_grid);
+    writer.write(_s_grid);
+    writer.write(std::uint64_t(_s2u_intervals));
+    writer.write(std::uint64_t(_s2u_tables.size()));
+    for (const auto& table: _s2u_tables)
+    {
+      table.save(writer);
+    }
+  }
+
+  V evaluate(S t) const noexcept
+  {
+    instrumentation::ScopedLatency latency(instrumentation::Api::evaluate);
+    _Hint hint;
+    return _evaluate(t, hint);
+  }
+
+  V evaluate_velocity(S t) const noexcept
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::evaluate_velocity);
+    _Hint hint;
+    return _evaluate_velocity(t, hint);
+  }
+
+  /// Position, velocity and acceleration (as well as speed and arc length)
+  /// at time t.  This needs only one arc length inversion, which makes it
+  /// about twice as fast as calling evaluate() and evaluate_velocity().
+  /// Position and velocity are exactly the same as with those.
+  ///
+  /// Like the velocity, the acceleration outside of the time range is
+  /// the one at the first/last time.
+  State evaluate_state(S t) const noexcept
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::evaluate_state);
+    _Hint hint;
+    return _evaluate_state(t, hint);
+  }
+
+  /// Evaluate positions at all times in [first, last) and write them to
+  /// "result".  Returns the iterator past the last written element.
+  ///
+  /// Segment indices and the previous arc length solution are re-used
+  /// from one time to the next, which is much faster than calling
+  /// evaluate() repeatedly if the times are sorted.  Unsorted times are
+  /// allowed as well, but they don't profit from this.
+  template<typename InputIt, typename OutputIt>
+  OutputIt evaluate_many(InputIt first, InputIt last, OutputIt result) const
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::evaluate_many);
+    _Hint hint;
+    for (; first != last; ++first, ++result)
+    {
+      *result = _evaluate(*first, hint);
+    }
+    return result;
+  }
+
+  /// Like evaluate_many(), but for velocities.
+  template<typename InputIt, typename OutputIt>
+  OutputIt evaluate_velocity_many(InputIt first, InputIt last
+      , OutputIt result) const
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::evaluate_velocity_many);
+    _Hint hint;
+    for (; first != last; ++first, ++result)
+    {
+      *result = _evaluate_velocity(*first, hint);
+    }
+    return result;
+  }
+
+  /// Evaluate positions at the arc lengths (measured from the beginning
+  /// of the path) in [first, last) and write them to "result".  Returns
+  /// the iterator past the last written element.  Arc lengths outside of
+  /// [0, total_length()] are clipped.
+  ///
+  /// For sorted arc lengths, this sweeps through the segments of the path
+  /// in one pass: each arc length is integrated from the previous one
+  /// (with a single low-order quadrature for short steps) and inverted
+  /// locally with Newton's method, therefore the cost grows linearly with
+  /// the number of points.  Unsorted values are allowed as well, but they
+  /// don't profit from this.
+  ///
+  /// Unlike evaluate(), this doesn't use s2u tables (see the constructor).
+  template<typename InputIt, typename OutputIt>
+  OutputIt evaluate_at_distance(InputIt first, InputIt last
+      , OutputIt result) const
+  {
+    _Sweep sweep;
+    for (; first != last; ++first, ++result)
+    {
+      *result = _evaluate_at_distance(*first, sweep);
+    }
+    return result;
+  }
+
+  /// Positions at the arc lengths 0, step, 2 * step, ... (up to
+  /// total_length()) are written to "result", see evaluate_at_distance().
+  /// Returns the iterator past the last written element.
+  template<typename OutputIt>
+  OutputIt sample_by_distance(S step, OutputIt result) const
+  {
+    if (!(step > 0))
+    {
+      throw std::runtime_error("sample_by_distance(): step must be positive");
+    }
+    auto n = static_cast<size_t>(std::floor(this->total_length() / step)) + 1;
+    _Sweep sweep;
+    for (size_t i = 0; i < n; ++i, ++result)
+    {
+      *result = _evaluate_at_distance(S(i) * step, sweep);
+    }
+    return result;
+  }
+
+  /// Arc length of the whole path
+  S total_length() const noexcept { return _s_grid.back(); }
+
+  /// Evaluate n positions at the times t_start + i / sample_rate
+  /// (with i = 0, ..., n - 1) and write them to out[i].
+  ///
+  /// Only some of the positions are evaluated exactly, the others are
+  /// computed by means of cubic Hermite interpolation (using the exact
+  /// positions and velocities at the ends of each interval), implemented
+  /// with forward differences (i.e. three vector additions per sample).
+  ///
+  /// Intervals are bisected until the error at their center is at most
+  /// "tolerance" and they don't contain vertex times (where the curve may
+  /// not be smooth).  Within smooth parts, the error of cubic Hermite
+  /// interpolation is bounded by h^4 / 384 times the maximum of the fourth
+  /// derivative (with h being the interval length).  This leading error
+  /// term is largest at the center of the interval, therefore the maximum
+  /// error is typically close to the error measured there (but it may
+  /// exceed "tolerance" somewhat).
+  template<typename RandomIt>
+  void render_block(S t_start, S sample_rate, size_t n, RandomIt out
+      , S tolerance = S(0.0001)) const
+  {
+    if (n == 0)
+    {
+      return;
+    }
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::render_block);
+    _Hint hint;
+    auto time = [t_start, sample_rate](size_t i) {
+      return t_start + S(i) / sample_rate;
+    };
+    auto evaluate = [this, &hint](S t) {
+      V position = _evaluate(t, hint);
+      V velocity = _evaluate_velocity(t, hint);
+      if (t < _grid.front() || _grid.back() < t)
+      {
+        // The position is constant outside of the time range
+        velocity *= S(0);
+      }
+      return std::pair{position, velocity};
+    };
+
+    auto refine = [&](auto& self, size_t i0, V p0, V v0
+        , size_t i1, V p1, V v1) -> void
+    {
+      if (i1 - i0 < 2)
+      {
+        return;
+      }
+      S t0 = time(i0);
+      S t1 = time(i1);
+      // Hermite coefficients, see CubicHermiteSpline
+      auto delta = t1 - t0;
+      std::array<V, 4> a{
+                p0                                             ,
+                                        delta * v0             ,
+        -S(3) * p0 + S(3) * p1 - S(2) * delta * v0 - delta * v1,
+         S(2) * p0 - S(2) * p1 +        delta * v0 + delta * v1};
+      size_t im = i0 + (i1 - i0) / 2;
+      auto [pm, vm] = evaluate(time(im));
+      auto vertex = std::upper_bound(_grid.begin(), _grid.end(), t0);
+      S x = S(im - i0) / S(i1 - i0);
+      if ((vertex == _grid.end() || t1 <= *vertex)
+          && length(((a[3] * x + a[2]) * x + a[1]) * x + a[0] - pm)
+            <= tolerance)
+      {
+        _forward_differences(a, i1 - i0, out + i0);
+      }
+      else
+      {
+        self(self, i0, p0, v0, im, pm, vm);
+        self(self, im, pm, vm, i1, p1, v1);
+      }
+      out[im] = pm;
+    };
+
+    auto [p0, v0] = evaluate(time(0));
+    out[0] = p0;
+    if (n > 1)
+    {
+      auto [p1, v1] = evaluate(time(n - 1));
+      out[n - 1] = p1;
+      refine(refine, 0, p0, v0, n - 1, p1, v1);
+    }
+  }
+
+  /// Approximate the whole spline by piecewise cubic Hermite
+  /// interpolation w.r.t. time, which can be evaluated without any
+  /// quadrature or root finding.
+  ///
+  /// Between two vertex times, the exact curve is smooth.  Starting with
+  /// one interval per vertex, intervals are bisected until the distance
+  /// between the interpolated and the exact positions is at most
+  /// "tolerance" everywhere (up to rounding errors and the accuracy of the
+  /// pre-computed arc lengths):
+  ///
+  /// - The distance is checked at equidistant samples.  Their number is
+  ///   chosen such that the distance can grow by at most tolerance / 4
+  ///   between them, based on upper bounds of the derivatives of the
+  ///   error in each interval (from the interpolating polynomial, the
+  ///   speed and its derivative from the time-to-length mapping and the
+  ///   curvature of the path, or only from the first derivatives if the
+  ///   velocity of the path gets close to zero).
+  /// - The exact positions at the samples are obtained by inverting the
+  ///   arc length, their error is at most the difference between the arc
+  ///   length of the solution and the requested one, which is added to
+  ///   the distance.
+  ///
+  /// If "velocity_tolerance" is given, the velocities at the samples must
+  /// be within half of it as well, which is not a guaranteed bound.
+  /// Positions (up to the inversion error) and (one-sided) velocities at
+  /// all knots are exact.
+  ///
+  /// std::runtime_error is thrown if the tolerance cannot be reached
+  /// within _bake_max_depth bisections of a vertex interval.  This
+  /// happens if the tolerance is close to the accuracy of the exact
+  /// positions (see _s2u_accuracy) or of S, or if the velocity changes
+  /// very quickly (e.g. near cusps) and a velocity tolerance is given.
+  ///
+  /// The result is a PiecewiseCubicCurve (with the same time range).
+  CubicHermiteSpline<S, V> bake(S tolerance
+      , std::optional<S> velocity_tolerance = std::nullopt) const
+  {
+    struct Sample
+    {
+      S t;
+      S u;
+      V position;
+      V velocity;
+      /// Upper bound of the distance between "position" and the exact
+      /// position (i.e. the arc length between them)
+      S error;
+    };
+
+    std::vector<V> positions;
+    std::vector<V> tangents;
+    std::vector<S> grid;
+
+    _Hint hint;
+    const auto& u_grid = _path.grid();
+    // Exact position and velocity within vertex interval "index"
+    auto sample = [this, &hint](size_t index, S t, S u, S error) {
+      V tangent = _path.segment_velocity(index, u);
+      if (S tangent_length = length(tangent))
+      {
+        tangent /= tangent_length;
+      }
+      return Sample{t, u, _path.evaluate(u, hint.path_index)
+        , _t2s.evaluate_velocity(t, hint.t2s_index) * tangent, error};
+    };
+    auto sample_inner = [&](size_t index, S t) {
+      S s = _t2s.evaluate(t, hint.t2s_index);
+      S u = std::clamp(_s2u(s, hint), u_grid[index], u_grid[index + 1]);
+      using std::abs;
+      return sample(index, t, u
+          , abs(_s_grid[index] + _path.segment_length_to(index, u) - s));
+    };
+
+    // Number of equidistant sub-intervals (an even number) between "left"
+    // and "right" for which the error can grow by at most tolerance / 4
+    // within each sub-interval, or 0 if more than _bake_max_samples would
+    // be needed.  "a" are the coefficients of the interpolation.
+    auto sub_intervals = [&](size_t index, const Sample& left
+        , const Sample& right, const std::array<V, 4>& a) -> size_t {
+      using std::abs, std::ceil, std::max, std::min, std::sqrt;
+      S delta = right.t - left.t;
+      S budget = tolerance / 4;
+
+      // Speed (quadratic) and its derivative (linear) within the segment
+      // of _t2s, which contains the whole interval
+      size_t j = hint.t2s_index;
+      _t2s.evaluate(left.t + delta / 2, j);
+      const auto& c = _t2s.segments()[j];
+      S t0 = _t2s.grid()[j];
+      S duration = _t2s.grid()[j + 1] - t0;
+      auto speed = [&c, duration](S x) {
+        return abs((S(3) * c[3] * x + S(2) * c[2]) * x + c[1]) / duration;
+      };
+      S xa = (left.t - t0) / duration;
+      S xb = (right.t - t0) / duration;
+      S max_speed = max(speed(xa), speed(xb));
+      if (c[3] != 0)
+      {
+        S x = -c[2] / (S(3) * c[3]);
+        if (xa < x && x < xb)
+        {
+          max_speed = max(max_speed, speed(x));
+        }
+      }
+      S max_speed_derivative = max(
+          abs(S(2) * c[2] + S(6) * c[3] * xa),
+          abs(S(2) * c[2] + S(6) * c[3] * xb)) / (duration * duration);
+
+      // First order: the error changes at most with the sum of speeds.
+      // The derivative of the interpolation is bounded by its Bernstein
+      // coefficients.
+      S max_velocity = max({
+          length(a[1]),
+          length(a[1] + a[2]),
+          length(a[1] + S(2) * a[2] + S(3) * a[3])}) / delta;
+      S result = ceil((max_velocity + max_speed) * delta / (2 * budget));
+
+      // Second order: the acceleration of the exact curve is at most
+      // |s''| + s'^2 * curvature, the curvature of the path is at most
+      // |P''| / |P'|^2.  P'' is linear, P' is bounded from below by its
+      // value at the center minus the maximum change.
+      const auto& b = _path.segments()[index];
+      S u0 = u_grid[index];
+      S du = u_grid[index + 1] - u0;
+      S pa = (left.u - u0) / du;
+      S pb = (right.u - u0) / du;
+      S pc = (pa + pb) / 2;
+      S max_path_acceleration = max(
+          length(S(2) * b[2] + S(6) * b[3] * pa),
+          length(S(2) * b[2] + S(6) * b[3] * pb)) / (du * du);
+      S min_path_velocity
+        = length((S(3) * b[3] * pc + S(2) * b[2]) * pc + b[1]) / du
+        - max_path_acceleration * (right.u - left.u) / 2;
+      if (min_path_velocity > 0)
+      {
+        S max_acceleration = max(
+            length(S(2) * a[2]),
+            length(S(2) * a[2] + S(6) * a[3])) / (delta * delta)
+          + max_speed_derivative + max_speed * max_speed
+          * max_path_acceleration / (min_path_velocity * min_path_velocity);
+        // Linear interpolation error
+        result = min(result
+            , ceil(delta * sqrt(max_acceleration / (S(8) * budget))));
+      }
+      // NB: This is also false for NaN
+      if (!(result <= S(_bake_max_samples)))
+      {
+        return 0;
+      }
+      return max(size_t(2), (static_cast<size_t>(result) + 1) / 2 * 2);
+    };
+
+    auto refine = [&](auto& self, size_t index, const Sample& left
+        , const Sample& right, size_t depth) -> void
+    {
+      auto delta = right.t - left.t;
+      const V& p0 = left.position;
+      const V& p1 = right.position;
+      const V& v0 = left.velocity;
+      const V& v1 = right.velocity;
+      // Hermite coefficients, see CubicHermiteSpline
+      std::array<V, 4> a{
+                p0                                             ,
+                                        delta * v0             ,
+        -S(3) * p0 + S(3) * p1 - S(2) * delta * v0 - delta * v1,
+         S(2) * p0 - S(2) * p1 +        delta * v0 + delta * v1};
+      size_t n = sub_intervals(index, left, right, a);
+      // The remaining error budget for the samples
+      S max_error = tolerance * 3 / 4;
+      bool accurate = n > 0
+        && left.error <= max_error && right.error <= max_error;
+      std::optional<Sample> center;
+      for (size_t i = 1; accurate && i < n; ++i)
+      {
+        S x = S(i) / S(n);
+        auto check = sample_inner(index, left.t + delta * x);
+        V position = ((a[3] * x + a[2]) * x + a[1]) * x + a[0];
+        V velocity = ((S(3) * a[3] * x + S(2) * a[2]) * x + a[1]) / delta;
+        if (length(position - check.position) + check.error > max_error
+            || (velocity_tolerance && length(velocity - check.velocity)
+              > *velocity_tolerance / 2))
+        {
+          accurate = false;
+        }
+        if (2 * i == n)
+        {
+          center = check;
+        }
+      }
+      if (accurate)
+      {
+        tangents.push_back(v0);
+        tangents.push_back(v1);
+        positions.push_back(p1);
+        grid.push_back(right.t);
+        return;
+      }
+      if (!center)
+      {
+        center = sample_inner(index, left.t + delta / 2);
+      }
+      if (depth >= _bake_max_depth
+          || !(left.t < center->t && center->t < right.t))
+      {
+        throw std::runtime_error("bake(): tolerance cannot be reached");
+      }
+      self(self, index, left, *center, depth + 1);
+      self(self, index, *center, right, depth + 1);
+    };
+
+    positions.push_back(_path.evaluate(u_grid.front()));
+    grid.push_back(_grid.front());
+    for (size_t index = 0; index < _grid.size() - 1; ++index)
+    {
+      refine(refine, index
+          , sample(index, _grid[index], u_grid[index], 0)
+          , sample(index, _grid[index + 1], u_grid[index + 1], 0), 0);
+    }
+    return {positions, tangents, grid};
+  }
+
+  /// Change the position of vertex i (which must not be CLOSED).
+  ///
+  /// Only the (up to 4) affected segments of the path and their arc
+  /// lengths (and their part of the s2u table, if available) are
+  /// re-computed.  Arc lengths of later vertices are shifted and the
+  /// time-to-length mapping is re-created (which doesn't need quadrature).
+  /// If this fails (e.g. because the new arc lengths are incompatible
+  /// with the given speeds), the spline is not modified.
+  ///
+  /// NB: This must not be called while evaluating in another thread.
+  ///     SplineCursor objects notice the change and reset their state.
+  void update_vertex(size_t i, V position)
+  {
+    const auto& vertices = _path.vertices();
+    if (i >= vertices.size())
+    {
+      throw std::out_of_range("Vertex index out of range");
+    }
+    V old_position = vertices[i];
+    auto segments = _path.update_vertex(i, position);
+    try
+    {
+      _update_t2s();
+    }
+    catch (...)
+    {
+      _path.update_vertex(i, old_position);
+      throw;
+    }
+    _update_path(segments);
+  }
+
+  /// Change (or remove) time and speed of vertex i.
+  ///
+  /// The same rules as in the constructor apply: the time of the last
+  /// vertex must be given, the first one defaults to 0 and speed is only
+  /// allowed if time is given.
+  ///
+  /// The path is not changed, only the time-to-length mapping
+  /// is re-created.  If this fails, the spline is not modified.
+  void update_time(size_t i, std::optional<S> time
+      , std::optional<S> speed = std::nullopt)
+  {
+    if (i >= _times.size())
+    {
+      throw std::out_of_range("Vertex index out of range");
+    }
+    if (!time)
+    {
+      if (i == 0)
+      {
+        time = 0;
+      }
+      else if (i == _times.size() - 1)
+      {
+        throw std::runtime_error("Time of last vertex must be specified");
+      }
+      else if (speed)
+      {
+        throw std::runtime_error("Speed is only allowed if time is given");
+      }
+    }
+    auto old_time = std::exchange(_times[i], time);
+    auto old_speed = std::exchange(_speeds[i], speed);
+    try
+    {
+      _update_t2s();
+    }
+    catch (...)
+    {
+      _times[i] = old_time;
+      _speeds[i] = old_speed;
+      throw;
+    }
+    _revision = _next_revision();
+  }
+
+  /// Change tension, continuity and bias of vertex i.
+  ///
+  /// This is not allowed for the first (except for closed curves) and the
+  /// last vertex.  Only the 2 adjacent segments of the path are
+  /// re-computed, see update_vertex().
+  void update_tcb(size_t i, std::array<S, 3> tcb)
+  {
+    auto old_tcb = _path.tcb(i);
+    auto segments = _path.update_tcb(i, tcb);
+    try
+    {
+      _update_t2s();
+    }
+    catch (...)
+    {
+      _path.update_tcb(i, old_tcb);
+      throw;
+    }
+    _update_path(segments);
+  }
+
+  /// Append a vertex with the given time (which must be later than the
+  /// time of the last vertex) to an open spline, e.g. for live input.
+  ///
+  /// "tcb" belongs to the previously last vertex, which becomes an inner
+  /// vertex.  Only the last two segments of the path (the end tangent of
+  /// the previously last one changes) and the last few segments of the
+  /// time-to-length mapping are (re-)computed, as well as the times of
+  /// vertices without time within those.  The result is the same as if
+  /// the spline had been created with all vertices (up to rounding
+  /// errors of the cumulative sums).  Search structures are updated in
+  /// amortized constant time (see GridIndex::update() and
+  /// BoundingSphereTree::extend()), therefore the cost doesn't depend on
+  /// the number of vertices.
+  ///
+  /// If this throws, the spline is not modified.
+  ///
+  /// NB: This must not be called while evaluating in another thread,
+  ///     see update_vertex().
+  void append_vertex(V position, S time, std::optional<S> speed = std::nullopt
+      , std::array<S, 3> tcb = {})
+  {
+    if (!(_grid.back() < time))
+    {
+      throw std::runtime_error(
+          "Time of appended vertex must be later than the last time");
+    }
+    auto changed = _path.append_vertex(position, tcb);
+    try
+    {
+      _append_t2s(time, speed);
+    }
+    catch (...)
+    {
+      _path.remove_last_vertex();
+      throw;
+    }
+    auto n = _path.grid().size();
+    auto first = changed.front();
+    _times.push_back(time);
+    _speeds.push_back(speed);
+    _grid.push_back(time);
+    _s_grid.resize(n);
+    for (size_t i = first + 1; i < n; ++i)
+    {
+      _s_grid[i] = _path.cumulative_length(i);
+    }
+    _s_grid_index.update(_s_grid, first + 1);
+    _update_missing_times();
+    if (!_s2u_tables.empty())
+    {
+      for (auto index: changed)
+      {
+        if (index < _s2u_tables.size())
+        {
+          _s2u_tables[index] = _create_s2u_table(index);
+        }
+        else
+        {
+          _s2u_tables.push_back(_create_s2u_table(index));
+        }
+      }
+    }
+    // The last segment changes again on the next call
+    const auto& segments = _path.segments();
+    if (_bounds.covered() > first)
+    {
+      _bounds.build(segments, segments.size() - 1);
+    }
+    else
+    {
+      _bounds.extend(segments, segments.size() - 1);
+    }
+    _revision = _next_revision();
+  }
+
+  /// Remove the first "count" vertices of an open spline (e.g. to limit
+  /// the history of live input, see append_vertex()).
+  /// At least two vertices must remain, and the new first vertex must
+  /// have a time.
+  ///
+  /// The remaining segments don't change (even though the new first
+  /// vertex would have a different end tangent in a new spline), times
+  /// stay the same, but arc lengths start at zero at the new first
+  /// vertex.  This takes linear time in the number of remaining vertices
+  /// (to re-build search structures), which is why it should be called
+  /// for many vertices at once.
+  void discard_vertices(size_t count)
+  {
+    if (count + 2 > _times.size())
+    {
+      throw std::out_of_range("At least two vertices must remain");
+    }
+    if (!_times[count])
+    {
+      throw std::runtime_error("New first vertex must have a time");
+    }
+    auto knots = static_cast<size_t>(std::count_if(
+          _times.begin(), _times.begin() + count
+          , [](const auto& time) { return time.has_value(); }));
+    S offset = _s_grid[count];
+    auto covered = std::max(_bounds.covered(), count) - count;
+    _path.erase_front(count);
+    _t2s.erase_front(knots, offset);
+    auto erase = [count](auto& values) {
+      values.erase(values.begin(), values.begin() + count);
+    };
+    erase(_times);
+    erase(_speeds);
+    erase(_grid);
+    erase(_s_grid);
+    for (size_t i = 0; i < _s_grid.size(); ++i)
+    {
+      _s_grid[i] = _path.cumulative_length(i);
+    }
+    _s_grid_index.build(_s_grid);
+    if (!_s2u_tables.empty())
+    {
+      erase(_s2u_tables);
+    }
+    _bounds.build(_path.segments(), covered);
+    _revision = _next_revision();
+  }
+
+  auto& grid() const { return _grid; }
+
+  /// Point on the path of the spline that's closest to "point".
+  /// If there are multiple closest points, any one of them is returned.
+  ///
+  /// A hierarchy of bounding spheres (see BoundingSphereTree) is used to
+  /// skip all segments that are further away than the closest point
+  /// found so far.
+  ClosestPoint closest_point(V point) const
+  {
+    auto closest = _bounds.closest(_path.segments(), point);
+    auto index = closest.segment;
+    const auto& u_grid = _path.grid();
+    S u = u_grid[index] + (u_grid[index + 1] - u_grid[index]) * closest.x;
+    return {_path.evaluate(u, index), closest.distance
+      , _segment_time(closest.segment, closest.x), _segment_arc_length(
+          closest.segment, closest.x)};
+  }
+
+  /// Time intervals (sorted, non-overlapping) within [t0, t1] during which
+  /// the distance to "point" is at most "radius".
+  ///
+  /// Before the first and after the last vertex time, the position
+  /// doesn't change, t0 and t1 may be outside of that range.
+  /// Bounding spheres (see BoundingSphereTree) are used to find segments
+  /// that are completely inside or outside of the radius, the remaining
+  /// ones are subdivided.  Interval boundaries are accurate to about
+  /// 10^-6 of the duration of their segment.
+  std::vector<std::pair<S, S>> time_intervals_within(V point, S radius
+      , S t0, S t1) const
+  {
+    std::vector<std::pair<S, S>> result;
+    if (t1 < t0)
+    {
+      return result;
+    }
+    S front = _grid.front();
+    S back = _grid.back();
+    S begin = std::clamp(t0, front, back);
+    S end = std::clamp(t1, front, back);
+    auto segments = _grid.size() - 1;
+    // Segments that overlap [begin, end]
+    auto first = std::min(static_cast<size_t>(std::upper_bound(
+          _grid.begin(), _grid.end(), begin) - _grid.begin()), segments) - 1;
+    auto last = std::min(static_cast<size_t>(std::upper_bound(
+          _grid.begin(), _grid.end(), end) - _grid.begin()), segments);
+    // Adjacent ranges are merged before converting them to times
+    struct Position
+    {
+      size_t index;
+      S x;
+    };
+    std::optional<std::pair<Position, Position>> pending;
+    auto flush = [this, begin, end, &result, &pending]() {
+      auto [from, to] = *pending;
+      S a = std::max(_segment_time(from.index, from.x), begin);
+      S b = std::min(_segment_time(to.index, to.x), end);
+      if (a > b)
+      {
+        return;
+      }
+      if (!result.empty() && a <= result.back().second)
+      {
+        result.back().second = std::max(result.back().second, b);
+      }
+      else
+      {
+        result.emplace_back(a, b);
+      }
+    };
+    _bounds.within(_path.segments(), point, radius, first, last
+        , [&pending, &flush](size_t index, S x0, S x1) {
+      if (pending)
+      {
+        auto& to = pending->second;
+        if ((to.index == index && to.x == x0)
+            || (to.index + 1 == index && to.x == 1 && x0 == 0))
+        {
+          to = {index, x1};
+          return;
+        }
+        flush();
+      }
+      pending = {{index, x0}, {index, x1}};
+    });
+    if (pending)
+    {
+      flush();
+    }
+    if (!result.empty())
+    {
+      // The spline stands still outside of its time range
+      if (result.front().first <= front)
+      {
+        result.front().first = t0;
+      }
+      if (result.back().second >= back)
+      {
+        result.back().second = t1;
+      }
+      result.front().first = std::max(result.front().first, t0);
+      result.back().second = std::min(result.back().second, t1);
+    }
+    return result;
+  }
+
+  /// Same as above, for the whole time range of the spline.
+  std::vector<std::pair<S, S>> time_intervals_within(V point, S radius) const
+  {
+    return this->time_intervals_within(
+        point, radius, _grid.front(), _grid.back());
+  }
+
+private:
+  friend class SplineCursor<S, V>;
+  friend class AsdfScene<S, V>;
+  friend struct AsdfSplineInternals<S, V>;
+
+  struct Initializer;
+
+  /// The vertices (and times and speeds) are moved from "init".
+  AsdfSpline(Initializer&& init, size_t s2u_knots)
+  : _path(std::move(init.vertices), init.tcb, init.closed, init.pool.get()
+      , init.resource)
+  , _times(std::move(init.times))
+  , _speeds(std::move(init.speeds))
+  , _t2s(_create_t2s())
+  , _grid(_create_grid(_t2s, init.pool.get()))
+  , _s_grid(init.resource)
+  , _s2u_intervals(s2u_knots)
+  , _s2u_tables(init.resource)
+  , _s_grid_index(init.resource)
+  , _bounds(init.resource)
+  {
     assert(_path.grid().size() == _grid.size());
-    std::transform(_grid.begin(), _grid.end(), std::back_inserter(_s_grid)
-        , [this](S t){ return _t2s.evaluate(t); });
+    _s_grid.reserve(_grid.size());
+    for (size_t i = 0; i < _grid.size(); ++i)
+    {
+      _s_grid.push_back(_path.cumulative_length(i));
+    }
+    _s_grid_index.build(_s_grid);
+    _bounds.build(_path.segments());
+    if (_s2u_intervals)
+    {
+      auto segments = _s_grid.size() - 1;
+      _s2u_tables.reserve(segments);
+      if (init.pool)
+      {
+        // "resource" doesn't have to be thread-safe, therefore the knots
+        // are allocated from a synchronized scratch resource in the worker
+        // threads and the tables are created in this thread
+        std::pmr::synchronized_pool_resource scratch(init.resource);
+        std::pmr::vector<std::optional<_S2uKnots>> knots(
+            segments, init.resource);
+        parallel_for(init.pool.get(), segments, _s2u_chunk_size
+            , [this, &knots, &scratch](size_t begin, size_t end) {
+          for (size_t index = begin; index < end; ++index)
+          {
+            knots[index].emplace(_create_s2u_knots(index, &scratch));
+          }
+        });
+        for (const auto& k: knots)
+        {
+          _s2u_tables.push_back(_create_s2u_table(*k));
+        }
+      }
+      else
+      {
+        for (size_t index = 0; index < segments; ++index)
+        {
+          _s2u_tables.push_back(_create_s2u_table(index));
+        }
+      }
+    }
+  }
+
+  /// Memory resource of all vectors (_times is the first one to be
+  /// initialized in the constructors)
+  std::pmr::memory_resource* _resource() const
+  {
+    return _times.get_allocator().resource();
   }
 
-  V evaluate(S t) const
+  /// Search state that is carried from one evaluation to the next.
+  struct _Hint
   {
-    return _path.evaluate(_s2u(_t2s.evaluate(t)));
+    size_t t2s_index = 0;
+    size_t path_index = 0;
+    /// Index within the s2u table of segment path_index
+    size_t s2u_table_index = 0;
+
+    /// Previous (non-clipped) solution of _s2u()
+    struct Solution
+    {
+      S s;
+      S u;
+      size_t index;
+      /// Speed along _path at u (i.e. derivative of s w.r.t. u)
+      S speed;
+    };
+    std::optional<Solution> solution;
+  };
+
+  V _evaluate(S t, _Hint& hint) const noexcept
+  {
+    S u = _s2u(_t2s.evaluate(t, hint.t2s_index), hint);
+    return _path.evaluate(u, hint.path_index);
   }
 
-  V evaluate_velocity(S t) const
+  V _evaluate_velocity(S t, _Hint& hint) const noexcept
   {
-    S speed = _t2s.evaluate_velocity(t);
-    V tangent = _path.evaluate_velocity(_s2u(_t2s.evaluate(t)));
+    S speed = _t2s.evaluate_velocity(t, hint.t2s_index);
+    S u = _s2u(_t2s.evaluate(t, hint.t2s_index), hint);
+    V tangent = _path.evaluate_velocity(u, hint.path_index);
     if (S tangent_length = length(tangent))
     {
       tangent /= tangent_length;
@@ -57,19 +1043,162 @@ public:
     return speed * tangent;
   }
 
-  auto& grid() const { return _grid; }
+  /// Arc length at the normalized parameter x within segment "index"
+  /// of _path
+  S _segment_arc_length(size_t index, S x) const noexcept
+  {
+    const auto& u_grid = _path.grid();
+    if (x >= 1)
+    {
+      return _path.cumulative_length(index + 1);
+    }
+    S u = u_grid[index] + (u_grid[index + 1] - u_grid[index]) * x;
+    return _path.cumulative_length(index) + _path.segment_length_to(index, u);
+  }
 
-private:
-  struct Initializer;
+  /// Time at the normalized parameter x within segment "index" of _path
+  S _segment_time(size_t index, S x) const
+  {
+    if (x <= 0)
+    {
+      return _grid[index];
+    }
+    if (x >= 1)
+    {
+      return _grid[index + 1];
+    }
+    // NB: The arc lengths of the vertices are strictly increasing,
+    //     therefore there is always a unique solution
+    auto time = _t2s.get_time(_segment_arc_length(index, x));
+    assert(time);
+    return std::clamp(time.value_or(_grid[index]), _grid[index]
+        , _grid[index + 1]);
+  }
 
-  /// If s is outside, return clipped u.
-  S _s2u(S s) const
+  /// The acceleration is the derivative of speed * tangent, i.e. the
+  /// tangential acceleration plus speed^2 times the curvature vector.
+  /// The latter is the component of the second derivative of _path
+  /// (w.r.t. u) that's normal to the tangent, divided by |r'(u)|^2.
+  State _evaluate_state(S t, _Hint& hint) const noexcept
+  {
+    auto [s, speed, tangential] = _t2s.evaluate_derivatives(
+        t, hint.t2s_index);
+    S u = _s2u(s, hint);
+    auto [position, tangent, r2] = _path.evaluate_derivatives(
+        u, hint.path_index);
+    // NB: This is zero if the tangent is zero
+    V acceleration = tangential * tangent;
+    if (S tangent_length = length(tangent))
+    {
+      tangent /= tangent_length;
+      acceleration = tangential * tangent;
+      V normal = r2;
+      if (S r2_length = length(r2))
+      {
+        // V only has to provide length(), therefore the dot product is
+        // calculated with the polarization identity (of unit vectors,
+        // to avoid cancellation)
+        V unit = r2 / r2_length;
+        S plus = length(tangent + unit);
+        S minus = length(tangent - unit);
+        normal -= tangent * (r2_length * (plus * plus - minus * minus) / 4);
+      }
+      acceleration += normal * (speed * speed
+          / (tangent_length * tangent_length));
+    }
+    else
+    {
+      speed = 0;
+    }
+    return {position, speed * tangent, acceleration, speed, s};
+  }
+
+  /// State of a sweep along _path, see _sweep_to()
+  struct _Sweep
   {
-    static_assert(std::is_same_v<S, float>
-        , "For now, this only works with float");
+    /// Segment of _path, only valid if "anchored"
+    size_t index = 0;
+    bool anchored = false;
+    /// Arc length (from the beginning of _path) at the parameter u
+    S s = 0;
+    S u = 0;
+    /// Speed along _path at u
+    S speed = 0;
+  };
 
-    // TODO: proper accuracy (a bit less than single-precision?)
-    auto accuracy = S(0.0001);
+  V _evaluate_at_distance(S s, _Sweep& sweep) const noexcept
+  {
+    S u = _sweep_to(s, sweep);
+    // NB: A copy, because the sweep is anchored in its segment
+    size_t index = sweep.index;
+    return _path.evaluate(u, index);
+  }
+
+  /// Parameter of _path at arc length s (clipped, if s is outside).
+  ///
+  /// The sweep is anchored at the beginning of a segment (found with
+  /// _s_grid_index) when it enters a new segment or goes backwards.
+  /// Within a segment, only the arc length between the previous and the
+  /// new point is integrated.  The anchor is moved to the solution, using
+  /// the arc length integrated up to the solution (not the requested one),
+  /// therefore the root finding errors don't accumulate (and quadrature
+  /// errors only until the next segment).
+  S _sweep_to(S s, _Sweep& sweep) const noexcept
+  {
+    if (s <= _s_grid.front() || _s_grid.back() <= s)
+    {
+      bool front = s <= _s_grid.front();
+      sweep.anchored = false;
+      sweep.index = front ? 0 : _s_grid.size() - 2;
+      return front ? _path.grid().front() : _path.grid().back();
+    }
+    if (!sweep.anchored || s < sweep.s || _s_grid[sweep.index + 1] <= s)
+    {
+      auto index = _s_grid_index.find(_s_grid, s, sweep.index);
+      S u = _path.grid()[index];
+      sweep = {index, true, _s_grid[index], u
+        , length(_path.segment_velocity(index, u))};
+    }
+    auto index = sweep.index;
+    S u0 = sweep.u;
+    S u1 = _path.grid()[index + 1];
+    auto target = s - sweep.s;
+    S guess = (sweep.speed > 0) ? u0 + target / sweep.speed
+      : u0 + (u1 - u0) * target / (_s_grid[index + 1] - sweep.s);
+    S speed = 0;
+    S evaluated = u0;
+    auto func = [&](S u){
+      evaluated = u;
+      speed = length(_path.segment_velocity(index, u));
+      return std::pair{_path.segment_length_between(index, u0, u) - target
+        , speed};
+    };
+    auto result = newton(func, guess, u0, u1, _s2u_accuracy
+        , _s2u_max_iterations);
+    S u = result.x;
+    // The residual belongs to the last evaluated u, newton() might have
+    // applied one more (tiny) step, which is extrapolated linearly
+    sweep.s = s + result.residual + speed * (u - evaluated);
+    sweep.u = u;
+    sweep.speed = speed;
+    return u;
+  }
+
+  /// If s is outside, return clipped u.
+  ///
+  /// The segments hint.path_index and the next one are checked before
+  /// using _s_grid_index (_s_grid and the grid of _path have the same
+  /// size).
+  ///
+  /// If there are s2u tables, they are used.  Otherwise:
+  /// The derivative of the arc length is the speed along _path,
+  /// therefore Newton's method can be used.  If there is a previous
+  /// solution, it limits the search range (because u is monotonically
+  /// increasing with s) and it is used for the initial guess.
+  S _s2u(S s, _Hint& hint) const noexcept
+  {
+    auto accuracy = _s2u_accuracy;
+    instrumentation::count(instrumentation::Counter::s2u_calls);
 
     size_t index;
     if (s <= _s_grid.front())
@@ -78,27 +1207,469 @@ private:
     }
     else if (s < _s_grid.back())
     {
-      index = std::upper_bound(_s_grid.begin(), _s_grid.end(), s)
-        - _s_grid.begin() - 1;
+      if (hint.solution && hint.solution->s == s)
+      {
+        return hint.solution->u;
+      }
+      index = _s_grid_index.find(_s_grid, s, hint.path_index);
     }
     else
     {
       return _path.grid().back();
     }
-    s -= _s_grid[index];
+    if (!_s2u_tables.empty())
+    {
+      hint.path_index = index;
+      return _path.grid()[index] + _s2u_tables[index].evaluate(
+          s - _s_grid[index], hint.s2u_table_index);
+    }
     S u0 = _path.grid()[index];
     S u1 = _path.grid()[index + 1];
+    S umin = u0;
+    S umax = u1;
+    auto target = s - _s_grid[index];
+    // Initial guess: linear interpolation
+    S guess = u0 + (u1 - u0) * target / (_s_grid[index + 1] - _s_grid[index]);
+    if (hint.solution)
+    {
+      const auto& previous = *hint.solution;
+      // The previous solution is only accurate up to "accuracy"
+      if (previous.s < s)
+      {
+        umin = std::clamp(previous.u - accuracy, u0, u1);
+      }
+      else
+      {
+        umax = std::clamp(previous.u + accuracy, u0, u1);
+      }
+      if (previous.index == index && previous.speed > 0)
+      {
+        // Linear extrapolation from previous solution
+        guess = previous.u + (s - previous.s) / previous.speed;
+      }
+    }
+    S speed = 0;
     auto func = [&](S u){
-      return _path.segment_length(index, u0, u) - s;
+      speed = length(_path.segment_velocity(index, u));
+      return std::pair{_path.segment_length_to(index, u) - target, speed};
     };
-    return bisect(func, u0, u1, accuracy, 50);
+    // NB: "speed" belongs to the last u passed to func(), which might be
+    //     slightly different from the result (but it's only used for
+    //     an initial guess anyway).
+    auto result = newton(func, guess, umin, umax, accuracy
+        , _s2u_max_iterations);
+    instrumentation::count(
+        instrumentation::Counter::s2u_iterations, result.calls);
+    instrumentation::count(
+        instrumentation::Counter::s2u_max_iterations, result.calls);
+    S u = result.x;
+    hint.path_index = index;
+    hint.solution = typename _Hint::Solution{s, u, index, speed};
+    return u;
   }
 
-  std::unique_ptr<Initializer> _init;
+  /// Check times and lengths from BinaryReader (the grids of _path and
+  /// _t2s have already been checked by their constructors).
+  bool _valid_grids() const
+  {
+    if (!is_finite_and_ascending(_grid.begin(), _grid.end(), false)
+        || !is_finite_and_ascending(_s_grid.begin(), _s_grid.end(), false)
+        || !_times.front() || !_times.back()
+        || _t2s.grid().front() != _grid.front()
+        || _t2s.grid().back() != _grid.back())
+    {
+      return false;
+    }
+    for (size_t i = 0; i < _times.size(); ++i)
+    {
+      if (_times[i] && *_times[i] != _grid[i])
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static BinaryReader<S>& _read_header(BinaryReader<S>& reader)
+  {
+    if (reader.template read<std::array<char, 8>>() != _format_magic)
+    {
+      throw std::runtime_error("Binary data is not an ASDF spline");
+    }
+    if (reader.template read<std::uint32_t>() != _format_version)
+    {
+      throw std::runtime_error("Unsupported binary format version");
+    }
+    if (reader.template read<std::uint8_t>() != sizeof(S)
+        || reader.template read<std::uint8_t>() != sizeof(V) / sizeof(S))
+    {
+      throw std::runtime_error("Binary data has different scalar or "
+                               "vector type");
+    }
+    return reader;
+  }
+
+  /// Time-to-length mapping for all vertices with given time
+  MonotoneCubicSpline<S> _create_t2s() const
+  {
+    auto resource = _resource();
+    auto given = _times.size() - static_cast<size_t>(
+        std::count(_times.begin(), _times.end(), std::nullopt));
+    std::pmr::vector<S> lengths(resource);
+    std::pmr::vector<std::optional<S>> speeds(resource);
+    std::pmr::vector<S> times(resource);
+    lengths.reserve(given);
+    speeds.reserve(given);
+    times.reserve(given);
+    for (size_t i = 0; i < _times.size(); ++i)
+    {
+      if (_times[i])
+      {
+        lengths.push_back(_path.cumulative_length(i));
+        speeds.push_back(_speeds[i]);
+        times.push_back(*_times[i]);
+      }
+    }
+    return MonotoneCubicSpline<S>(std::move(lengths), speeds, times, resource);
+  }
+
+  /// Given times and times of the remaining vertices obtained from t2s.
+  /// If a "pool" is given, the missing times are solved in parallel.
+  std::pmr::vector<S> _create_grid(const MonotoneCubicSpline<S>& t2s
+      , WorkerPool* pool = nullptr) const
+  {
+    auto resource = _resource();
+    std::pmr::vector<S> grid(resource);
+    grid.reserve(_times.size());
+    std::pmr::vector<S> lengths(resource);
+    lengths.reserve(static_cast<size_t>(
+        std::count(_times.begin(), _times.end(), std::nullopt)));
+    for (size_t i = 0; i < _times.size(); ++i)
+    {
+      if (!_times[i])
+      {
+        lengths.push_back(_path.cumulative_length(i));
+      }
+    }
+    // NB: Lengths are sorted, this is faster than separate get_time() calls
+    //     (the segment search restarts at the beginning of each chunk,
+    //     which doesn't change the results)
+    std::pmr::vector<std::optional<S>> missing_times(lengths.size(), resource);
+    parallel_for(pool, lengths.size(), _chunk_size
+        , [&t2s, &lengths, &missing_times](size_t begin, size_t end) {
+      t2s.get_times(lengths.begin() + begin, lengths.begin() + end
+          , missing_times.begin() + begin);
+    });
+    auto missing = missing_times.begin();
+    for (const auto& time: _times)
+    {
+      if (time)
+      {
+        grid.push_back(*time);
+      }
+      else if (*missing)
+      {
+        grid.push_back(**missing++);
+      }
+      else
+      {
+        throw std::runtime_error("duplicate vertex without time");
+      }
+    }
+    return grid;
+  }
+
+  void _update_t2s()
+  {
+    auto t2s = _create_t2s();
+    auto grid = _create_grid(t2s);
+    _t2s = std::move(t2s);
+    // NB: The size doesn't change, values are overwritten to keep
+    //     references to the data valid
+    assert(grid.size() == _grid.size());
+    std::copy(grid.begin(), grid.end(), _grid.begin());
+  }
+
+  /// Append the last vertex of _path (with the given time) to _t2s.
+  ///
+  /// The arc length of the previously last vertex has changed, which
+  /// changes the slopes of the two knots before it, therefore the last
+  /// five knots (including the new one) are passed to update_tail().
+  /// If this throws, _t2s is not modified.
+  void _append_t2s(S time, std::optional<S> speed)
+  {
+    auto resource = _resource();
+    std::pmr::vector<S> lengths(resource);
+    std::pmr::vector<std::optional<S>> speeds(resource);
+    std::pmr::vector<S> times(resource);
+    lengths.reserve(_t2s_window);
+    speeds.reserve(_t2s_window);
+    times.reserve(_t2s_window);
+    for (size_t i = _times.size(); i-- > 0 && times.size() + 1 < _t2s_window;)
+    {
+      if (_times[i])
+      {
+        lengths.push_back(_path.cumulative_length(i));
+        speeds.push_back(_speeds[i]);
+        times.push_back(*_times[i]);
+      }
+    }
+    std::reverse(lengths.begin(), lengths.end());
+    std::reverse(speeds.begin(), speeds.end());
+    std::reverse(times.begin(), times.end());
+    lengths.push_back(_path.cumulative_length(_times.size()));
+    speeds.push_back(speed);
+    times.push_back(time);
+    auto first = _t2s.grid().size() + 1 - times.size();
+    _t2s.update_tail(first, lengths, speeds, times);
+  }
+
+  /// Re-solve the times of vertices without time after the knot of _t2s
+  /// that precedes the changed ones (see _append_t2s()).
+  void _update_missing_times()
+  {
+    // The last vertex has a time, the two knots before it have changed
+    size_t knots = 0;
+    size_t i = _times.size() - 1;
+    while (i > 0 && knots < _t2s_window - 2)
+    {
+      --i;
+      knots += _times[i].has_value();
+    }
+    for (++i; i < _times.size() - 1; ++i)
+    {
+      if (!_times[i])
+      {
+        // NB: Arc lengths of vertices are strictly increasing, therefore
+        //     there is always a unique solution
+        auto time = _t2s.get_time(_path.cumulative_length(i));
+        assert(time);
+        _grid[i] = time.value_or(_grid[i - 1]);
+      }
+    }
+  }
+
+  /// Update everything else that depends on _path (_t2s and _grid have
+  /// already been updated) after the given segments (sorted indices) have
+  /// been modified.  Only arc lengths after the first one are shifted.
+  void _update_path(const std::vector<size_t>& segments)
+  {
+    assert(!segments.empty());
+    auto first = segments.front() + 1;
+    for (size_t i = first; i < _s_grid.size(); ++i)
+    {
+      _s_grid[i] = _path.cumulative_length(i);
+    }
+    _s_grid_index.update(_s_grid, first);
+    _bounds.update(_path.segments(), segments);
+    if (!_s2u_tables.empty())
+    {
+      for (auto index: segments)
+      {
+        _s2u_tables[index] = _create_s2u_table(index);
+      }
+    }
+    _revision = _next_revision();
+  }
+
+  /// Write the values of the polynomial with coefficients "a" (w.r.t.
+  /// a parameter in the range [0, 1]) at the parameters i / steps to
+  /// out[i] (with 0 < i < steps).
+  template<typename RandomIt>
+  static void _forward_differences(const std::array<V, 4>& a
+      , size_t steps, RandomIt out)
+  {
+    S h = S(1) / S(steps);
+    V value = a[0];
+    V first = ((a[3] * h + a[2]) * h + a[1]) * h;
+    V third = S(6) * a[3] * h * h * h;
+    V second = third + S(2) * a[2] * h * h;
+    for (size_t i = 1; i < steps; ++i)
+    {
+      value += first;
+      first += second;
+      second += third;
+      out[i] = value;
+    }
+  }
+
+  /// Interpolation points of an s2u table (relative to the segment start)
+  struct _S2uKnots
+  {
+    std::pmr::vector<S> values;
+    std::pmr::vector<S> tangents;
+    std::pmr::vector<S> grid;
+  };
+
+  /// Piecewise cubic Hermite interpolation of the inverse arc length u(s)
+  /// within the given segment of _path.
+  /// Both s and u are relative to the start of the segment.
+  ///
+  /// Interpolation points are placed at _s2u_intervals equidistant
+  /// u values, the tangents are the inverse speed at those points.
+  /// Intervals are bisected until the error at three points within them
+  /// is below _s2u_accuracy (or until _s2u_max_depth is reached).
+  /// If necessary, tangents are limited to keep u(s) monotone.
+  CubicHermiteSpline<S, S> _create_s2u_table(size_t index) const
+  {
+    return _create_s2u_table(_create_s2u_knots(index, _resource()));
+  }
+
+  CubicHermiteSpline<S, S> _create_s2u_table(const _S2uKnots& knots) const
+  {
+    return {knots.values, knots.tangents, knots.grid, nullptr, _resource()};
+  }
+
+  /// Interpolation points of _create_s2u_table(), allocated from
+  /// "resource".
+  _S2uKnots _create_s2u_knots(size_t index
+      , std::pmr::memory_resource* resource) const
+  {
+    struct Knot
+    {
+      /// Relative to the start of the segment
+      S s;
+      S u;
+      S slope;
+    };
+
+    auto make_knot = [this, index](S s, S u) {
+      S speed = length(_path.segment_velocity(index, u));
+      return Knot{s, u, (speed > 0)
+        ? S(1) / speed : std::numeric_limits<S>::infinity()};
+    };
+
+    auto tangents_of = [](const Knot& a, const Knot& b) {
+      // See Fritsch and Carlson (1980), "Monotone Piecewise Cubic
+      // Interpolation": tangents up to 3 times the secant are monotone.
+      S secant = (b.u - a.u) / (b.s - a.s);
+      using std::min;
+      return std::pair{min(a.slope, 3 * secant), min(b.slope, 3 * secant)};
+    };
+
+    auto interpolate = [&tangents_of](const Knot& a, const Knot& b, S s) {
+      auto [d0, d1] = tangents_of(a, b);
+      S h = b.s - a.s;
+      S x = (s - a.s) / h;
+      return (1 + 2 * x) * (1 - x) * (1 - x) * a.u
+        + x * (1 - x) * (1 - x) * h * d0
+        + x * x * (3 - 2 * x) * b.u
+        + x * x * (x - 1) * h * d1;
+    };
+
+    S u0 = _path.grid()[index];
+    S u1 = _path.grid()[index + 1];
+    std::pmr::vector<S> values(resource), tangents(resource), grid(resource);
+    values.push_back(0);
+    grid.push_back(0);
+
+    auto add_interval = [&](const Knot& a, const Knot& b) {
+      auto [d0, d1] = tangents_of(a, b);
+      tangents.push_back(d0);
+      tangents.push_back(d1);
+      values.push_back(b.u - u0);
+      grid.push_back(b.s);
+    };
+
+    auto refine = [&](auto& self, const Knot& a, const Knot& b
+        , size_t depth) -> void
+    {
+      if (depth < _s2u_max_depth)
+      {
+        // Check error at 1/4, 1/2 and 3/4 of the interval
+        std::array<S, 3> u, s;
+        bool accurate = true;
+        for (size_t i = 0; i < 3; ++i)
+        {
+          u[i] = a.u + (b.u - a.u) * S(i + 1) / 4;
+          s[i] = _path.segment_length_to(index, u[i]);
+          using std::abs;
+          if (s[i] < b.s && abs(interpolate(a, b, s[i]) - u[i]) > _s2u_accuracy)
+          {
+            accurate = false;
+          }
+        }
+        if (!accurate && a.s < s[1] && s[1] < b.s)
+        {
+          auto mid = make_knot(s[1], u[1]);
+          self(self, a, mid, depth + 1);
+          self(self, mid, b, depth + 1);
+          return;
+        }
+      }
+      add_interval(a, b);
+    };
+
+    S s1 = _path.segment_length_to(index, u1);
+    auto left = make_knot(0, u0);
+    for (size_t i = 1; i < _s2u_intervals; ++i)
+    {
+      S u = u0 + (u1 - u0) * S(i) / S(_s2u_intervals);
+      S s = _path.segment_length_to(index, u);
+      if (s >= s1)
+      {
+        // This may happen due to rounding errors
+        break;
+      }
+      auto right = make_knot(s, u);
+      refine(refine, left, right, 0);
+      left = right;
+    }
+    refine(refine, left, make_knot(s1, u1), 0);
+    return {std::move(values), std::move(tangents), std::move(grid)};
+  }
+
+  /// Globally unique, so that a SplineCursor can tell different splines
+  /// apart even if one is created at the address of another one
+  static size_t _next_revision() noexcept
+  {
+    static std::atomic<size_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  // TODO: proper accuracy (a bit less than single-precision?)
+  static constexpr S _s2u_accuracy = S(0.0001);
+  /// Upper limit for function evaluations in _s2u().  Bisection alone
+  /// would reach _s2u_accuracy within about 30 steps for any segment
+  /// shorter than 10^5 (in curve parameter units), which is the
+  /// square root of the chord length.
+  static constexpr size_t _s2u_max_iterations = 50;
+  static constexpr size_t _s2u_max_depth = 10;
+  /// Number of knots of _t2s that are re-computed in append_vertex()
+  static constexpr size_t _t2s_window = 5;
+  /// Maximum number of bisections of a vertex interval in bake()
+  static constexpr size_t _bake_max_depth = 20;
+  /// Maximum number of sub-intervals checked per interval in bake(),
+  /// intervals that would need more are bisected without checking
+  static constexpr size_t _bake_max_samples = 32;
+  /// Number of vertices per chunk for parallel construction
+  static constexpr size_t _chunk_size = 1024;
+  /// Number of s2u tables per chunk for parallel construction
+  static constexpr size_t _s2u_chunk_size = 16;
+
+  static constexpr std::array<char, 8> _format_magic{
+    'A', 'S', 'D', 'F', 'S', 'P', 'L', 'N'};
+  /// Must be incremented on any change of the binary format
+  /// (including changes of pre-computed values, e.g. the number of
+  /// sub-intervals in PiecewiseCubicCurve).
+  static constexpr std::uint32_t _format_version = 2;
+
   CentripetalKochanekBartelsSpline<S, V> _path;
+  /// Given time of each vertex (the first one defaults to 0)
+  std::pmr::vector<std::optional<S>> _times;
+  std::pmr::vector<std::optional<S>> _speeds;
   MonotoneCubicSpline<S> _t2s;
-  std::vector<S> _grid;
-  std::vector<S> _s_grid;
+  std::pmr::vector<S> _grid;
+  std::pmr::vector<S> _s_grid;
+  /// Initial number of s2u table intervals per segment (0 means no table)
+  size_t _s2u_intervals;
+  /// One table per segment of _path (or none)
+  std::pmr::vector<CubicHermiteSpline<S, S>> _s2u_tables;
+  GridIndex<S> _s_grid_index;
+  /// Bounding spheres of the segments of _path
+  BoundingSphereTree<S, V> _bounds;
+  /// Changed on each modification, see SplineCursor
+  size_t _revision = _next_revision();
 };
 
 
@@ -106,12 +1677,24 @@ template<typename S, typename V>
 struct AsdfSpline<S, V>::Initializer
 {
   template<typename C>
-  explicit Initializer(const C& data)
+  Initializer(const C& data, size_t threads
+      , std::pmr::memory_resource* resource)
+  : resource(resource)
+  , vertices(resource)
+  , times(resource)
+  , speeds(resource)
+  , tcb(resource)
   {
     if (data.size() < 2)
     {
       throw std::runtime_error("At least two vertices are required");
     }
+    // Room for the two temporary vertices of closed curves,
+    // see CentripetalKochanekBartelsSpline
+    this->vertices.reserve(data.size() + 1);
+    this->times.reserve(data.size());
+    this->speeds.reserve(data.size());
+    this->tcb.reserve(data.size());
 
     this->closed = std::holds_alternative<CLOSED>(data.back().position);
 
@@ -129,13 +1712,11 @@ struct AsdfSpline<S, V>::Initializer
 
       if (current.time)
       {
-        this->times.push_back(*current.time);
-        this->speeds.push_back(current.speed);
+        this->times.push_back(current.time);
       }
       else if (i == 0)
       {
         this->times.push_back(0);
-        this->speeds.push_back(current.speed);
       }
       else if (i == data.size() - 1)
       {
@@ -143,12 +1724,13 @@ struct AsdfSpline<S, V>::Initializer
       }
       else
       {
-        this->missing_times.push_back(i);
+        this->times.emplace_back();
         if (current.speed)
         {
           throw std::runtime_error("Speed is only allowed if time is given");
         }
       }
+      this->speeds.push_back(current.speed);
       if ((this->closed || 0 < i) && i < data.size() - 1)
       {
         this->tcb.push_back(current.tcb);
@@ -159,54 +1741,20 @@ struct AsdfSpline<S, V>::Initializer
                                  "closed curves) and last vertex");
       }
     }
-  }
-
-  auto get_t2s_arguments(const CentripetalKochanekBartelsSpline<S, V>& path)
-  {
-    std::vector<S> lengths;
-    lengths.push_back(0);
-
-    for (size_t i = 0; i < path.grid().size() - 1; ++i)
+    if (threads > 1)
     {
-      S length = path.segment_length(i);
-      if (std::find(this->missing_times.begin()
-                  , this->missing_times.end(), i) != this->missing_times.end())
-      {
-        this->lengths_at_missing_times.push_back(lengths.back());
-        lengths.back() += length;
-      }
-      else
-      {
-        lengths.push_back(lengths.back() + length);
-      }
-    }
-    return std::make_tuple(lengths, this->speeds, this->times);
-  }
-
-  auto get_grid(const MonotoneCubicSpline<S>& t2s)
-  {
-    assert(this->missing_times.size() == this->lengths_at_missing_times.size());
-    for (size_t i = 0; i < this->missing_times.size(); ++i)
-    {
-      if (auto time = t2s.get_time(this->lengths_at_missing_times[i]))
-      {
-        this->times.insert(times.begin() + this->missing_times[i], *time);
-      }
-      else
-      {
-        throw std::runtime_error("duplicate vertex without time");
-      }
+      this->pool = std::make_unique<WorkerPool>(threads);
     }
-    return this->times;
   }
 
+  std::pmr::memory_resource* resource;
   bool closed;
-  std::vector<V> vertices;
-  std::vector<S> times;
-  std::vector<size_t> missing_times;
-  std::vector<std::optional<S>> speeds;
-  std::vector<std::array<S, 3>> tcb;
-  std::vector<S> lengths_at_missing_times;
+  std::pmr::vector<V> vertices;
+  std::pmr::vector<std::optional<S>> times;
+  std::pmr::vector<std::optional<S>> speeds;
+  std::pmr::vector<std::array<S, 3>> tcb;
+  /// Only used during construction (nullptr for a single thread)
+  std::unique_ptr<WorkerPool> pool;
 };
 
 }  // namespace asdf
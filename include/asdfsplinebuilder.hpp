@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <memory>  // for unique_ptr, make_unique()
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>  // for runtime_error
+#include <vector>
+
+#include "asdfspline.hpp"
+
+namespace asdf {
+
+/// Incremental construction of an open AsdfSpline from vertices that
+/// arrive one at a time (e.g. from live tracking data), see
+/// AsdfSpline::append_vertex().
+///
+/// Each append takes amortized constant time, independent of the number
+/// of vertices.  All vertices need a time (which must be later than the
+/// previous one).
+///
+/// If a "window" is given, vertices that are older than that (relative
+/// to the latest time) are discarded.  To keep this amortized constant
+/// time as well, they are discarded in batches (as soon as there are at
+/// least as many expired vertices as remaining ones), therefore the
+/// spline holds up to about twice the history of the window.
+///
+///     asdf::AsdfSplineBuilder<float, Vec3> builder(10.0f);
+///     builder.append_vertex(position, time);
+///     ...
+///     if (auto spline = builder.spline())
+///     {
+///       spline->evaluate(time);
+///     }
+template<typename S, typename V>
+class AsdfSplineBuilder
+{
+public:
+  /// "s2u_knots" and "resource" are passed to the AsdfSpline constructor.
+  explicit AsdfSplineBuilder(std::optional<S> window = std::nullopt
+      , size_t s2u_knots = 0
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _window(window)
+  , _s2u_knots(s2u_knots)
+  , _resource(resource)
+  {
+    if (_window && !(*_window > 0))
+    {
+      throw std::runtime_error("Window must be positive");
+    }
+  }
+
+  /// Append a vertex.  Unlike in AsdfSpline::append_vertex(), "tcb"
+  /// belongs to the new vertex: it is only used once the next vertex
+  /// arrives (because the last vertex doesn't have a tangent that could
+  /// be changed).  The first vertex doesn't allow "tcb".
+  ///
+  /// If this throws, nothing is changed.
+  void append_vertex(V position, S time, std::optional<S> speed = std::nullopt
+      , std::array<S, 3> tcb = {})
+  {
+    if (!_spline && !_first)
+    {
+      if (tcb != std::array<S, 3>{})
+      {
+        throw std::runtime_error("TCB is not allowed for the first vertex");
+      }
+      _first = typename AsdfSpline<S, V>::AsdfVertex{position, time, speed};
+      return;
+    }
+    if (!_spline)
+    {
+      if (!(*_first->time < time))
+      {
+        throw std::runtime_error(
+            "Time of appended vertex must be later than the last time");
+      }
+      std::vector<typename AsdfSpline<S, V>::AsdfVertex> vertices{
+        *_first, {position, time, speed}};
+      _spline = std::make_unique<AsdfSpline<S, V>>(
+          vertices, _s2u_knots, 1, _resource);
+      _first.reset();
+    }
+    else
+    {
+      _spline->append_vertex(position, time, speed, _tcb);
+    }
+    _tcb = tcb;
+    if (_window)
+    {
+      _discard_expired();
+    }
+  }
+
+  /// The spline of all (non-discarded) vertices so far, or nullptr if
+  /// there are fewer than two.
+  ///
+  /// NB: The spline is modified by append_vertex(), which must not be
+  ///     called while evaluating in another thread.  It can be copied
+  ///     for publishing with a SplineHandle.
+  const AsdfSpline<S, V>* spline() const noexcept { return _spline.get(); }
+
+private:
+  void _discard_expired()
+  {
+    const auto& times = _spline->grid();
+    S start = times.back() - *_window;
+    // The last vertex before the window is kept
+    while (_expired + 2 < times.size() && times[_expired + 1] <= start)
+    {
+      ++_expired;
+    }
+    if (_expired > 0 && _expired >= times.size() - _expired)
+    {
+      _spline->discard_vertices(_expired);
+      _expired = 0;
+    }
+  }
+
+  std::optional<S> _window;
+  size_t _s2u_knots;
+  std::pmr::memory_resource* _resource;
+  /// Until the second vertex arrives
+  std::optional<typename AsdfSpline<S, V>::AsdfVertex> _first;
+  std::unique_ptr<AsdfSpline<S, V>> _spline;
+  /// TCB of the last vertex, see append_vertex()
+  std::array<S, 3> _tcb{};
+  /// Number of vertices (from the beginning) that are older than the window
+  size_t _expired = 0;
+};
+
+}  // namespace asdf
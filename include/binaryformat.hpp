@@ -0,0 +1,339 @@
+#pragma once
+
+#include <array>
+#include <cmath>  // for isfinite()
+#include <cstdint>
+#include <cstring>  // for memcpy()
+#include <iterator>  // for prev()
+#include <optional>
+#include <stdexcept>  // for runtime_error
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace asdf {
+
+using std::size_t;
+
+/// Common definitions of BinaryWriter and BinaryReader.
+///
+/// All numbers are stored in little-endian byte order (independent of the
+/// host), sizes are stored as 64-bit unsigned integers and booleans as
+/// single bytes.  A vector type V (e.g. Vec3<S>) is stored as
+/// sizeof(V) / sizeof(S) scalars of type S.
+/// std::optional values are stored as a boolean, followed by the value
+/// (only if there is one).
+///
+/// On little-endian hosts, arrays of scalars and vectors are copied as
+/// a whole.
+template<typename S>
+class BinaryFormat
+{
+protected:
+  /// Whether T is stored exactly like its representation in memory
+  /// (on a little-endian host)
+  template<typename T>
+  static constexpr bool _is_plain()
+  {
+    if constexpr (std::is_same_v<T, bool>)
+    {
+      return false;
+    }
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+      return true;
+    }
+    else if constexpr (_is_array<T>::value)
+    {
+      return _is_plain<typename T::value_type>();
+    }
+    else if constexpr (_is_optional<T>::value)
+    {
+      // NB: std::optional may be trivially copyable, but its
+      //     representation (flag, padding) depends on the ABI
+      return false;
+    }
+    else
+    {
+      // Vector type V
+      return std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(S) == 0;
+    }
+  }
+
+  template<typename T> struct _is_array : std::false_type {};
+
+  template<typename T, size_t N>
+  struct _is_array<std::array<T, N>> : std::true_type {};
+
+  template<typename T> struct _is_optional : std::false_type {};
+
+  template<typename T>
+  struct _is_optional<std::optional<T>> : std::true_type {};
+
+  /// Unsigned integer with the same size as a scalar
+  template<typename T>
+  using _unsigned = std::conditional_t<sizeof(T) == 1, std::uint8_t,
+                    std::conditional_t<sizeof(T) == 2, std::uint16_t,
+                    std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                                                       std::uint64_t>>>;
+
+  static bool _little_endian()
+  {
+    std::uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+  }
+};
+
+/// Whether all values in [first, last) are finite and ascending
+/// (strictly, if "strict").  Data from BinaryReader has to be validated
+/// with this before it is used for searching (e.g. with GridIndex).
+template<typename It>
+bool is_finite_and_ascending(It first, It last, bool strict)
+{
+  for (auto it = first; it != last; ++it)
+  {
+    using std::isfinite;
+    if (!isfinite(*it)
+        || (it != first && (strict ? !(*std::prev(it) < *it)
+                                   : !(*std::prev(it) <= *it))))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Serialization into a byte string, see BinaryFormat.
+template<typename S>
+class BinaryWriter : private BinaryFormat<S>
+{
+public:
+  /// Write a scalar or a vector of scalars (see BinaryFormat)
+  template<typename T>
+  void write(const T& value)
+  {
+    if constexpr (std::is_same_v<T, bool>)
+    {
+      _write_number(std::uint8_t(value));
+    }
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+      _write_number(value);
+    }
+    else
+    {
+      static_assert(std::is_trivially_copyable_v<T>
+          && sizeof(T) % sizeof(S) == 0, "Unsupported type");
+      std::array<S, sizeof(T) / sizeof(S)> components;
+      std::memcpy(components.data(), &value, sizeof(T));
+      for (auto component: components)
+      {
+        _write_number(component);
+      }
+    }
+  }
+
+  template<typename T, size_t N>
+  void write(const std::array<T, N>& values)
+  {
+    for (const auto& value: values)
+    {
+      this->write(value);
+    }
+  }
+
+  template<typename T>
+  void write(const std::optional<T>& value)
+  {
+    this->write(value.has_value());
+    if (value)
+    {
+      this->write(*value);
+    }
+  }
+
+  /// The number of elements is stored before the elements
+  template<typename T, typename A>
+  void write(const std::vector<T, A>& values)
+  {
+    _write_number(std::uint64_t(values.size()));
+    if constexpr (_base::template _is_plain<T>())
+    {
+      if (_base::_little_endian())
+      {
+        _buffer.append(reinterpret_cast<const char*>(values.data())
+            , values.size() * sizeof(T));
+        return;
+      }
+    }
+    for (const auto& value: values)
+    {
+      this->write(value);
+    }
+  }
+
+  /// Everything that has been written so far
+  const std::string& data() const { return _buffer; }
+
+private:
+  using _base = BinaryFormat<S>;
+
+  template<typename T>
+  void _write_number(T value)
+  {
+    static_assert(sizeof(T) <= 8, "Unsupported scalar type");
+    typename _base::template _unsigned<T> bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+      _buffer.push_back(static_cast<char>(
+            static_cast<unsigned char>(bits >> (8 * i))));
+    }
+  }
+
+  std::string _buffer;
+};
+
+/// Deserialization from a contiguous range of bytes (e.g. a memory-mapped
+/// file or a byte string created by BinaryWriter), see BinaryFormat.
+///
+/// std::runtime_error is thrown if the data ends prematurely.
+///
+/// NB: The data must outlive the reader (but not the objects created
+///     from it).
+template<typename S>
+class BinaryReader : private BinaryFormat<S>
+{
+public:
+  BinaryReader(const void* data, size_t size)
+  : _position(static_cast<const unsigned char*>(data))
+  , _end(_position + size)
+  {}
+
+  template<typename T>
+  void read(T& value)
+  {
+    if constexpr (std::is_same_v<T, bool>)
+    {
+      value = _read_number<std::uint8_t>() != 0;
+    }
+    else if constexpr (std::is_arithmetic_v<T>)
+    {
+      value = _read_number<T>();
+    }
+    else
+    {
+      static_assert(std::is_trivially_copyable_v<T>
+          && sizeof(T) % sizeof(S) == 0, "Unsupported type");
+      std::array<S, sizeof(T) / sizeof(S)> components;
+      for (auto& component: components)
+      {
+        component = _read_number<S>();
+      }
+      std::memcpy(static_cast<void*>(&value), components.data(), sizeof(T));
+    }
+  }
+
+  template<typename T, size_t N>
+  void read(std::array<T, N>& values)
+  {
+    for (auto& value: values)
+    {
+      this->read(value);
+    }
+  }
+
+  template<typename T>
+  void read(std::optional<T>& value)
+  {
+    bool has_value;
+    this->read(has_value);
+    if (has_value)
+    {
+      T temp;
+      this->read(temp);
+      value = temp;
+    }
+    else
+    {
+      value.reset();
+    }
+  }
+
+  /// The vector keeps its allocator, it is resized only once
+  template<typename T, typename A>
+  void read(std::vector<T, A>& values)
+  {
+    auto size = _read_number<std::uint64_t>();
+    // Each element needs at least one byte, this avoids huge allocations
+    // for invalid data
+    if (size > remaining())
+    {
+      throw std::runtime_error("Unexpected end of binary data");
+    }
+    if constexpr (_base::template _is_plain<T>())
+    {
+      if (_base::_little_endian())
+      {
+        _require(size * sizeof(T));
+        values.resize(size);
+        std::memcpy(static_cast<void*>(values.data()), _position
+            , size * sizeof(T));
+        _position += size * sizeof(T);
+        return;
+      }
+    }
+    values.resize(size);
+    for (auto& value: values)
+    {
+      this->read(value);
+    }
+  }
+
+  /// Convenience function, e.g. for member initializers
+  template<typename T>
+  T read()
+  {
+    T value{};
+    this->read(value);
+    return value;
+  }
+
+  /// Number of bytes that have not been read yet
+  size_t remaining() const { return static_cast<size_t>(_end - _position); }
+
+private:
+  using _base = BinaryFormat<S>;
+
+  void _require(size_t bytes) const
+  {
+    if (bytes > remaining())
+    {
+      throw std::runtime_error("Unexpected end of binary data");
+    }
+  }
+
+  template<typename T>
+  T _read_number()
+  {
+    static_assert(sizeof(T) <= 8, "Unsupported scalar type");
+    _require(sizeof(T));
+    typename _base::template _unsigned<T> bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+      bits |= static_cast<decltype(bits)>(
+          static_cast<decltype(bits)>(_position[i]) << (8 * i));
+    }
+    _position += sizeof(T);
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+  }
+
+  const unsigned char* _position;
+  const unsigned char* _end;
+};
+
+}  // namespace asdf
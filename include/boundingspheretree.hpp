@@ -0,0 +1,599 @@
+#pragma once
+
+#include <algorithm>  // for lower_bound(), max(), min()
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>  // for numeric_limits
+#include <memory_resource>
+#include <utility>  // for pair, swap()
+#include <vector>
+
+#include "newton.hpp"
+
+namespace asdf {
+
+using std::size_t;
+
+/// Bounding volume hierarchy for the segments of a PiecewiseCubicCurve,
+/// used for closest point and proximity queries.
+///
+/// Bounding spheres are used instead of boxes, because V only has to
+/// provide vector arithmetic and length() (but no access to individual
+/// components).  The sphere of a segment encloses its Bezier control
+/// points (and therefore, because of the convex hull property, the whole
+/// segment).  The tree is a balanced binary tree over ranges of
+/// consecutive segments, which are spatially coherent along a curve.
+///
+/// The segments themselves are not stored, they have to be passed to the
+/// queries.  After any change of the segments, build() has to be called
+/// again, unless only a few segments have changed (see update()) or
+/// segments have only been appended (see extend()).
+///
+/// Segments that are not covered by the hierarchy (i.e. the ones after
+/// "count" in build() and extend()) are checked individually by the
+/// queries.  This is meant for a few segments at the end of a curve that
+/// may still change.
+template<typename S, typename V>
+class BoundingSphereTree
+{
+public:
+  struct Sphere
+  {
+    V center;
+    S radius;
+  };
+
+  /// Result of closest()
+  struct Closest
+  {
+    size_t segment;
+    /// Normalized parameter within the segment, see PiecewiseCubicCurve
+    S x;
+    S distance;
+  };
+
+  explicit BoundingSphereTree(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _nodes(resource)
+  , _roots(resource)
+  {}
+
+  /// "segments" holds polynomial coefficients, see PiecewiseCubicCurve.
+  template<typename C>
+  void build(const C& segments)
+  {
+    this->build(segments, segments.size());
+  }
+
+  /// Same as above, but only the first "count" segments are covered by
+  /// the hierarchy.
+  template<typename C>
+  void build(const C& segments, size_t count)
+  {
+    assert(count <= segments.size());
+    assert(segments.size() <= UINT32_MAX);
+    _nodes.clear();
+    _roots.clear();
+    if (count)
+    {
+      _nodes.reserve(2 * count - 1);
+      _roots.push_back(_build(segments, 0, count));
+    }
+  }
+
+  /// Number of segments (from the beginning) in the hierarchy
+  size_t covered() const noexcept
+  {
+    return _roots.empty() ? 0 : _nodes[_roots.back()].last;
+  }
+
+  /// Cover the segments from the number of currently covered ones up to
+  /// "count" (the covered ones must not have been changed).
+  ///
+  /// Each new segment is added as a tree of its own, trees of the same
+  /// size are merged (like the digits of a binary counter), which takes
+  /// amortized constant time per segment.  The queries have to visit
+  /// the roots of all trees, but there are only logarithmically many.
+  template<typename C>
+  void extend(const C& segments, size_t count)
+  {
+    assert(count <= segments.size());
+    assert(segments.size() <= UINT32_MAX);
+    for (size_t i = covered(); i < count; ++i)
+    {
+      auto right = static_cast<std::uint32_t>(_nodes.size());
+      _nodes.push_back({_enclose(_control_points(segments[i]))
+          , static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(i + 1)
+          , 0, 0});
+      while (!_roots.empty() && _size(_roots.back()) == _size(right))
+      {
+        auto left = _roots.back();
+        _roots.pop_back();
+        const auto& one = _nodes[left];
+        const auto& two = _nodes[right];
+        auto parent = static_cast<std::uint32_t>(_nodes.size());
+        _nodes.push_back({_merge(one.sphere, two.sphere), one.first, two.last
+            , left, right});
+        right = parent;
+      }
+      _roots.push_back(right);
+    }
+  }
+
+  /// Re-compute the spheres of the given segments (sorted indices) and of
+  /// their ancestors after those segments have been changed.  Segments
+  /// that are not covered are ignored.  The result is the same as with
+  /// build(), but this takes only logarithmic time per segment.
+  template<typename C, typename I>
+  void update(const C& segments, const I& indices)
+  {
+    for (auto root: _roots)
+    {
+      _update(segments, indices, root);
+    }
+  }
+
+  /// Find the point on the curve that's closest to "point".
+  ///
+  /// Subtrees are skipped if their sphere is further away than the best
+  /// point found so far.  A first pass only checks the end points of
+  /// the segments, which is cheap and gives a good initial bound.
+  /// Within a segment, the squared distance is sampled and its local
+  /// minima are refined with Newton's method.
+  template<typename C>
+  Closest closest(const C& segments, V point) const noexcept
+  {
+    Closest best{0, 0, std::numeric_limits<S>::infinity()};
+    _depth_first(segments, point, best.distance
+        , [&segments, &point, &best](size_t i) {
+      const auto& a = segments[i];
+      S start = length(a[0] - point);
+      S end = length(a[0] + a[1] + a[2] + a[3] - point);
+      if (start < best.distance)
+      {
+        best = {i, 0, start};
+      }
+      if (end < best.distance)
+      {
+        best = {i, 1, end};
+      }
+    });
+    _depth_first(segments, point, best.distance
+        , [&segments, &point, &best](size_t i) {
+      auto candidate = _closest_on_segment(segments[i], point);
+      if (candidate.second < best.distance)
+      {
+        best = {i, candidate.first, candidate.second};
+      }
+    });
+    return best;
+  }
+
+  /// Call f(segment, x0, x1) for all parameter ranges [x0, x1] of the
+  /// segments [first, last) where the curve is within "radius" around
+  /// "point".  Ranges are reported in ascending order, adjacent ones
+  /// are not merged.
+  ///
+  /// If a sub-tree lies completely within the radius, f is called once
+  /// per segment (with x0 = 0 and x1 = 1).  Otherwise, the squared
+  /// distance minus radius^2 (a polynomial of degree 6) is converted to
+  /// Bernstein form and subdivided (with the de Casteljau algorithm)
+  /// until its coefficients have the same sign (i.e. the range is
+  /// completely inside or outside) or change their sign only once (i.e.
+  /// the range contains exactly one boundary, which is then found with
+  /// Newton's method).
+  template<typename C, typename F>
+  void within(const C& segments, V point, S radius, size_t first
+      , size_t last, F&& f) const
+  {
+    assert(first <= last && last <= segments.size());
+    // Returns true if the sphere needs further checks
+    auto check = [&](const Sphere& sphere, size_t begin, size_t end) {
+      if (end <= first || last <= begin
+          || _lower_bound(sphere, point) > radius)
+      {
+        return false;
+      }
+      if (length(sphere.center - point) + sphere.radius <= radius)
+      {
+        for (size_t i = std::max(begin, first); i < std::min(end, last); ++i)
+        {
+          f(i, S(0), S(1));
+        }
+        return false;
+      }
+      return true;
+    };
+    // The roots are sorted by their segments
+    for (auto root: _roots)
+    {
+      std::array<std::uint32_t, _max_depth> stack;
+      size_t size = 0;
+      stack[size++] = root;
+      while (size)
+      {
+        const auto& node = _nodes[stack[--size]];
+        if (!check(node.sphere, node.first, node.last))
+        {
+          continue;
+        }
+        if (node.last - node.first == 1)
+        {
+          _within_segment(segments[node.first], point, radius
+              , [&f, &node](S x0, S x1) { f(size_t(node.first), x0, x1); });
+          continue;
+        }
+        // Right child first, to report segments in ascending order
+        assert(size + 2 <= _max_depth);
+        stack[size++] = node.right;
+        stack[size++] = node.left;
+      }
+    }
+    for (size_t i = std::max(covered(), first); i < last; ++i)
+    {
+      if (check(_enclose(_control_points(segments[i])), i, i + 1))
+      {
+        _within_segment(segments[i], point, radius
+            , [&f, i](S x0, S x1) { f(i, x0, x1); });
+      }
+    }
+  }
+
+private:
+  struct _Node
+  {
+    Sphere sphere;
+    /// Range of segments [first, last)
+    std::uint32_t first;
+    std::uint32_t last;
+    /// Children (only for inner nodes)
+    std::uint32_t left;
+    std::uint32_t right;
+  };
+
+  std::uint32_t _size(std::uint32_t node) const noexcept
+  {
+    return _nodes[node].last - _nodes[node].first;
+  }
+
+  /// Call leaf(segment) for all segments whose sphere is closer to
+  /// "point" than "bound" (which may be changed by the calls).
+  /// Nearer subtrees are visited first.
+  template<typename C, typename F>
+  void _depth_first(const C& segments, const V& point, const S& bound
+      , F&& leaf) const noexcept
+  {
+    for (auto root: _roots)
+    {
+      std::array<std::uint32_t, _max_depth> stack;
+      size_t size = 0;
+      stack[size++] = root;
+      while (size)
+      {
+        const auto& node = _nodes[stack[--size]];
+        if (_lower_bound(node.sphere, point) >= bound)
+        {
+          continue;
+        }
+        if (node.last - node.first == 1)
+        {
+          leaf(size_t(node.first));
+          continue;
+        }
+        // The nearer child is pushed last (and therefore visited first)
+        std::uint32_t near = node.left;
+        std::uint32_t far = node.right;
+        if (_lower_bound(_nodes[far].sphere, point)
+            < _lower_bound(_nodes[near].sphere, point))
+        {
+          std::swap(near, far);
+        }
+        assert(size + 2 <= _max_depth);
+        stack[size++] = far;
+        stack[size++] = near;
+      }
+    }
+    for (size_t i = covered(); i < segments.size(); ++i)
+    {
+      if (_lower_bound(_enclose(_control_points(segments[i])), point) < bound)
+      {
+        leaf(i);
+      }
+    }
+  }
+
+  template<typename C, typename I>
+  void _update(const C& segments, const I& indices, std::uint32_t index)
+  {
+    auto& node = _nodes[index];
+    auto changed = std::lower_bound(
+        std::begin(indices), std::end(indices), size_t(node.first));
+    if (changed == std::end(indices) || *changed >= node.last)
+    {
+      return;
+    }
+    if (node.last - node.first == 1)
+    {
+      node.sphere = _enclose(_control_points(segments[node.first]));
+      return;
+    }
+    _update(segments, indices, node.left);
+    _update(segments, indices, node.right);
+    node.sphere = _merge(_nodes[node.left].sphere, _nodes[node.right].sphere);
+  }
+
+  template<typename C>
+  std::uint32_t _build(const C& segments, size_t first, size_t last)
+  {
+    auto index = static_cast<std::uint32_t>(_nodes.size());
+    _nodes.push_back({{}, static_cast<std::uint32_t>(first)
+        , static_cast<std::uint32_t>(last), 0, 0});
+    Sphere sphere;
+    if (last - first == 1)
+    {
+      sphere = _enclose(_control_points(segments[first]));
+    }
+    else
+    {
+      size_t middle = first + (last - first) / 2;
+      auto left = _build(segments, first, middle);
+      auto right = _build(segments, middle, last);
+      _nodes[index].left = left;
+      _nodes[index].right = right;
+      sphere = _merge(_nodes[left].sphere, _nodes[right].sphere);
+    }
+    _nodes[index].sphere = sphere;
+    return index;
+  }
+
+  /// Bezier control points of a segment with polynomial coefficients
+  static std::array<V, 4> _control_points(const std::array<V, 4>& a)
+  {
+    return {
+      a[0],
+      a[0] + a[1] / S(3),
+      a[0] + (S(2) * a[1] + a[2]) / S(3),
+      a[0] + a[1] + a[2] + a[3]};
+  }
+
+  /// Sphere around the centroid.  The radius is enlarged a bit, to make
+  /// sure that rounding errors don't make it too small.
+  static Sphere _enclose(const std::array<V, 4>& points)
+  {
+    V center = (points[0] + points[1] + points[2] + points[3]) / S(4);
+    S radius = 0;
+    for (const auto& p: points)
+    {
+      radius = std::max(radius, length(p - center));
+    }
+    return {center, radius + _margin(center, radius)};
+  }
+
+  static Sphere _merge(const Sphere& one, const Sphere& two)
+  {
+    S distance = length(two.center - one.center);
+    if (distance + two.radius <= one.radius)
+    {
+      return one;
+    }
+    if (distance + one.radius <= two.radius)
+    {
+      return two;
+    }
+    S radius = (distance + one.radius + two.radius) / 2;
+    V center = one.center
+      + (two.center - one.center) * ((radius - one.radius) / distance);
+    return {center, radius + _margin(center, radius)};
+  }
+
+  static S _margin(const V& center, S radius)
+  {
+    return 8 * std::numeric_limits<S>::epsilon() * (length(center) + radius);
+  }
+
+  static S _lower_bound(const Sphere& sphere, const V& point) noexcept
+  {
+    return std::max(S(0), length(sphere.center - point) - sphere.radius);
+  }
+
+  /// Dot product by means of the polarization identity (because V only
+  /// has to provide length()).  Unit vectors are used to avoid
+  /// cancellation.
+  static S _dot(const V& a, const V& b) noexcept
+  {
+    S a_length = length(a);
+    S b_length = length(b);
+    if (a_length == 0 || b_length == 0)
+    {
+      return 0;
+    }
+    V a_unit = a / a_length;
+    V b_unit = b / b_length;
+    S plus = length(a_unit + b_unit);
+    S minus = length(a_unit - b_unit);
+    return a_length * b_length * (plus * plus - minus * minus) / 4;
+  }
+
+  /// Polynomial coefficients (in ascending order) of the squared distance
+  /// between the segment and "point".  This needs only ten dot products,
+  /// afterwards everything can be done with scalars.
+  static std::array<S, 7> _squared_distance(const std::array<V, 4>& a
+      , const V& point) noexcept
+  {
+    std::array<V, 4> b{a[0] - point, a[1], a[2], a[3]};
+    std::array<S, 7> c{};
+    for (size_t i = 0; i < 4; ++i)
+    {
+      for (size_t j = i; j < 4; ++j)
+      {
+        c[i + j] += (i == j ? S(1) : S(2)) * _dot(b[i], b[j]);
+      }
+    }
+    return c;
+  }
+
+  /// Value and derivative of a polynomial (coefficients in ascending order)
+  template<size_t N>
+  static std::pair<S, S> _horner(const std::array<S, N>& c, S x) noexcept
+  {
+    S value = c[N - 1];
+    S derivative = 0;
+    for (size_t i = N - 1; i-- > 0;)
+    {
+      derivative = derivative * x + value;
+      value = value * x + c[i];
+    }
+    return {value, derivative};
+  }
+
+  /// Returns normalized parameter and distance.
+  static std::pair<S, S> _closest_on_segment(const std::array<V, 4>& a
+      , const V& point) noexcept
+  {
+    auto c = _squared_distance(a, point);
+    std::array<S, 6> derivative;
+    for (size_t i = 0; i < 6; ++i)
+    {
+      derivative[i] = S(i + 1) * c[i + 1];
+    }
+    // First and second derivative of the squared distance
+    auto func = [&derivative](S x) { return _horner(derivative, x); };
+    std::pair<S, S> best{0, std::numeric_limits<S>::infinity()};
+    auto check = [&best, &c](S x) {
+      S value = _horner(c, x).first;
+      if (value < best.second)
+      {
+        best = {x, value};
+      }
+    };
+    S previous_x = 0;
+    S previous_slope = func(previous_x).first;
+    check(previous_x);
+    for (size_t i = 1; i <= _samples; ++i)
+    {
+      S x = S(i) / S(_samples);
+      S slope = func(x).first;
+      check(x);
+      if (previous_slope < 0 && 0 < slope)
+      {
+        // Local minimum in between
+        auto result = newton(func, (previous_x + x) / 2, previous_x, x
+            , std::numeric_limits<S>::epsilon(), _max_iterations);
+        check(result.x);
+      }
+      previous_x = x;
+      previous_slope = slope;
+    }
+    // The polynomial is only used for finding the parameter, because
+    // of possible cancellation
+    S x = best.first;
+    return {x, length(((a[3] * x + a[2]) * x + a[1]) * x + a[0] - point)};
+  }
+
+  /// Calls f(x0, x1) in ascending order, see within()
+  template<typename F>
+  static void _within_segment(const std::array<V, 4>& a, const V& point
+      , S radius, F&& f)
+  {
+    auto c = _squared_distance(a, point);
+    c[0] -= radius * radius;
+    // Conversion to Bernstein basis
+    constexpr std::array<S, 7> binomial{1, 6, 15, 20, 15, 6, 1};
+    std::array<S, 7> b{};
+    for (size_t k = 0; k < 7; ++k)
+    {
+      S choose = 1;  // k choose i
+      for (size_t i = 0; i <= k; ++i)
+      {
+        b[k] += choose / binomial[i] * c[i];
+        choose = choose * S(k - i) / S(i + 1);
+      }
+    }
+    _within_bernstein(c, b, S(0), S(1), 0, f);
+  }
+
+  /// "c" are the polynomial coefficients over the whole segment, "b" the
+  /// Bernstein coefficients over [x0, x1].  Values <= 0 are inside.
+  template<typename F>
+  static void _within_bernstein(const std::array<S, 7>& c
+      , const std::array<S, 7>& b, S x0, S x1, size_t depth, F&& f)
+  {
+    size_t sign_changes = 0;
+    for (size_t i = 1; i < 7; ++i)
+    {
+      if ((b[i - 1] <= 0) != (b[i] <= 0))
+      {
+        ++sign_changes;
+      }
+    }
+    if (sign_changes == 0)
+    {
+      // The polynomial lies within the convex hull of its coefficients
+      if (b[0] <= 0)
+      {
+        f(x0, x1);
+      }
+      return;
+    }
+    if (sign_changes == 1)
+    {
+      // Exactly one root, which is bracketed by x0 and x1.
+      // newton() needs an increasing function.
+      bool entering = b[0] > 0;
+      auto func = [&c, entering](S x) {
+        auto result = _horner(c, x);
+        return entering ? std::pair{-result.first, -result.second} : result;
+      };
+      auto root = newton(func, (x0 + x1) / 2, x0, x1
+          , std::numeric_limits<S>::epsilon(), _max_iterations).x;
+      if (entering)
+      {
+        f(root, x1);
+      }
+      else
+      {
+        f(x0, root);
+      }
+      return;
+    }
+    S x = (x0 + x1) / 2;
+    if (depth >= _max_subdivisions)
+    {
+      // Multiple (nearly) touching roots, decide with the middle
+      if (_horner(c, x).first <= 0)
+      {
+        f(x0, x1);
+      }
+      return;
+    }
+    // de Casteljau
+    std::array<S, 7> left;
+    std::array<S, 7> right;
+    auto temp = b;
+    for (size_t i = 0; i < 7; ++i)
+    {
+      left[i] = temp[0];
+      right[6 - i] = temp[6 - i];
+      for (size_t j = 0; j + i < 6; ++j)
+      {
+        temp[j] = (temp[j] + temp[j + 1]) / 2;
+      }
+    }
+    _within_bernstein(c, left, x0, x, depth + 1, f);
+    _within_bernstein(c, right, x, x1, depth + 1, f);
+  }
+
+  /// Upper limit for the tree depth (more than enough for 2^32 segments)
+  static constexpr size_t _max_depth = 64;
+  /// Number of intervals for sampling the distance within a segment
+  static constexpr size_t _samples = 16;
+  static constexpr size_t _max_iterations = 30;
+  static constexpr size_t _max_subdivisions = 20;
+
+  std::pmr::vector<_Node> _nodes;
+  /// Trees with consecutive ranges of segments, see extend()
+  std::pmr::vector<std::uint32_t> _roots;
+};
+
+}  // namespace asdf
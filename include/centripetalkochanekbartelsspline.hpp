@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>  // for sort(), unique()
 #include <cmath>  // for sqrt(), pow()
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>  // for out_of_range, runtime_error
+#include <utility>  // for move(), forward()
 #include "cubichermitespline.hpp"
 
 namespace asdf {
@@ -12,31 +17,259 @@ private:
   using _base = CubicHermiteSpline<S, V>;
 
 public:
+  /// If a "pool" is given, the work for individual vertices and
+  /// segments is distributed to its threads.  The results are the same
+  /// for any number of threads.
+  ///
+  /// All vectors (including temporary ones) are allocated from "resource".
+  /// If "vertices" is an rvalue std::pmr::vector using the same resource,
+  /// it is moved (for closed curves, it should have capacity for two
+  /// more vertices, otherwise it is re-allocated once).
   template<typename C1, typename C2>
-  CentripetalKochanekBartelsSpline(const C1& vertices, const C2& tcb
-      , bool closed)
-  : _base(std::make_from_tuple<_base>(_init(vertices, tcb, closed)))
+  CentripetalKochanekBartelsSpline(C1&& vertices, const C2& tcb
+      , bool closed, WorkerPool* pool = nullptr
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : CentripetalKochanekBartelsSpline(
+      _init(std::forward<C1>(vertices), tcb, closed, pool, resource)
+      , tcb, closed, pool)
   {}
 
+  /// Restore a spline (including pre-computed arc lengths) that has been
+  /// stored with save().
+  explicit CentripetalKochanekBartelsSpline(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(reader, resource)
+  , _vertices(resource)
+  , _tcb(resource)
+  {
+    reader.read(_vertices);
+    reader.read(_tcb);
+    reader.read(_closed);
+    auto n = _vertices.size();
+    if (n + _closed != this->_grid.size()
+        || _tcb.size() + (_closed ? 0 : 2) != n
+        || !this->_has_lengths())
+    {
+      throw std::runtime_error("Invalid binary data for KB spline");
+    }
+  }
+
+  /// Store everything that's needed to restore the spline (including
+  /// pre-computed arc lengths), see BinaryFormat.
+  void save(BinaryWriter<S>& writer) const
+  {
+    _base::save(writer);
+    writer.write(_vertices);
+    writer.write(_tcb);
+    writer.write(_closed);
+  }
+
+  /// Change the position of vertex i.
+  ///
+  /// Only the (up to 4) segments whose shape depends on this vertex are
+  /// re-computed, the grid values of all later vertices are shifted.
+  /// Returns the sorted indices of the modified segments.
+  std::vector<size_t> update_vertex(size_t i, V vertex)
+  {
+    auto n = _vertices.size();
+    if (i >= n)
+    {
+      throw std::out_of_range("Vertex index out of range");
+    }
+    auto& grid = this->_grid;
+    auto segments = grid.size() - 1;
+
+    // Intervals (of the grid) before and after vertex i
+    std::array<std::optional<size_t>, 2> intervals;
+    std::array<S, 2> deltas{};
+    if (i > 0 || _closed)
+    {
+      intervals[0] = (i + n - 1) % n;
+    }
+    if (i < n - 1 || _closed)
+    {
+      intervals[1] = i;
+    }
+    for (size_t k = 0; k < 2; ++k)
+    {
+      if (intervals[k])
+      {
+        size_t j = *intervals[k];
+        V x0 = (j == i) ? vertex : _vertices[j];
+        V x1 = (j == i) ? _vertices[(j + 1) % n] : vertex;
+        deltas[k] = std::sqrt(length(x1 - x0));
+        if (deltas[k] == 0)
+        {
+          throw std::runtime_error("Repeated vertices are not possible");
+        }
+      }
+    }
+    _vertices[i] = vertex;
+
+    // Update grid, later values are shifted
+    size_t first = std::min(intervals[0].value_or(segments)
+                          , intervals[1].value_or(segments));
+    S previous = grid[first];
+    for (size_t j = first; j < segments; ++j)
+    {
+      S next = grid[j + 1];
+      S delta = next - previous;
+      for (size_t k = 0; k < 2; ++k)
+      {
+        if (intervals[k] == j)
+        {
+          delta = deltas[k];
+        }
+      }
+      grid[j + 1] = grid[j] + delta;
+      previous = next;
+    }
+
+    // Tangents of vertices i - 1, i and i + 1 have changed
+    // (and end tangents of open curves depend on their neighbors)
+    return _update_segments_around(i, 2, 2);
+  }
+
+  /// Change tension, continuity and bias of vertex i.
+  /// This is not allowed for the first and last vertex of open curves.
+  ///
+  /// Only the 2 segments adjacent to the vertex are re-computed.
+  /// Returns the sorted indices of the modified segments.
+  std::vector<size_t> update_tcb(size_t i, std::array<S, 3> tcb)
+  {
+    _tcb[_tcb_index(i)] = tcb;
+    return _update_segments_around(i, 1, 1);
+  }
+
+  auto& vertices() const { return _vertices; }
+
+  /// Tension, continuity and bias of vertex i, with the same restrictions
+  /// as in update_tcb().
+  std::array<S, 3> tcb(size_t i) const { return _tcb[_tcb_index(i)]; }
+
+  /// Append a vertex to an open curve.
+  ///
+  /// The previously last vertex becomes an inner vertex with the given
+  /// tension, continuity and bias.  Only the previously last segment
+  /// (whose end tangent changes) and the new one are computed, the cost
+  /// doesn't depend on the number of vertices (amortized).
+  /// Returns the sorted indices of the modified segments.
+  std::vector<size_t> append_vertex(V vertex, std::array<S, 3> tcb)
+  {
+    if (_closed)
+    {
+      throw std::runtime_error("Vertices can only be appended to open curves");
+    }
+    auto n = _vertices.size();
+    S delta = std::sqrt(length(vertex - _vertices[n - 1]));
+    if (delta == 0)
+    {
+      throw std::runtime_error("Repeated vertices are not possible");
+    }
+    auto& grid = this->_grid;
+    S end = grid.back() + delta;
+    _vertices.push_back(vertex);
+    _tcb.push_back(tcb);
+    this->_resize_segments(n);
+    grid[n] = end;
+    // Vertex n - 1 has become an inner vertex, its tangents have changed
+    // (the one of vertex 0 as well if n == 2, but that's segment 0 anyway)
+    return _update_tail(n - 2);
+  }
+
+  /// Remove the last vertex of an open curve with more than two vertices.
+  ///
+  /// This is the inverse of append_vertex(), the remaining segments are
+  /// the same as before appending.
+  void remove_last_vertex()
+  {
+    auto n = _vertices.size();
+    if (_closed || n <= 2)
+    {
+      throw std::runtime_error("Only open curves with more than two "
+                               "vertices can be shortened");
+    }
+    _vertices.pop_back();
+    _tcb.pop_back();
+    this->_resize_segments(n - 2);
+    _update_tail(n - 3);
+  }
+
+  /// Remove the first "count" vertices of an open curve.
+  ///
+  /// The shape of the remaining segments doesn't change (their
+  /// polynomial coefficients and grid values are kept), even though the
+  /// new first vertex loses its tension, continuity and bias values.
+  /// Arc lengths start at zero again.
+  void erase_front(size_t count)
+  {
+    if (_closed)
+    {
+      throw std::runtime_error("Vertices can only be removed from open curves");
+    }
+    if (count + 2 > _vertices.size())
+    {
+      throw std::out_of_range("At least two vertices must remain");
+    }
+    _vertices.erase(_vertices.begin(), _vertices.begin() + count);
+    _tcb.erase(_tcb.begin(), _tcb.begin() + count);
+    this->_erase_front(count);
+  }
+
 private:
-  template<typename C1, typename C2>
-  static auto _init(const C1& vertices_in, const C2& tcb, bool closed)
+  /// Arguments for the CubicHermiteSpline constructor.
+  /// For closed curves, the first vertex is repeated at the end.
+  struct _Parts
   {
-    std::tuple<std::vector<V>, std::vector<V>, std::vector<S>> result;
-    auto& [vertices, tangents, grid] = result;
+    std::pmr::vector<V> vertices;
+    std::pmr::vector<V> tangents;
+    std::pmr::vector<S> grid;
+  };
+
+  /// The vertices are moved from "parts", without the repeated one.
+  template<typename C2>
+  CentripetalKochanekBartelsSpline(_Parts&& parts, const C2& tcb
+      , bool closed, WorkerPool* pool)
+  : _base(parts.vertices, parts.tangents, std::move(parts.grid), pool
+      , parts.vertices.get_allocator().resource())
+  , _vertices(std::move(parts.vertices))
+  , _tcb(this->_resource())
+  , _closed(closed)
+  {
+    if (_closed)
+    {
+      _vertices.pop_back();
+    }
+    _tcb.reserve(tcb.size());
+    for (const auto& [T, C, B]: tcb)
+    {
+      _tcb.push_back({T, C, B});
+    }
+    this->_compute_lengths(pool);
+  }
 
+  template<typename C1, typename C2>
+  static _Parts _init(C1&& vertices_in, const C2& tcb, bool closed
+      , WorkerPool* pool, std::pmr::memory_resource* resource)
+  {
     if (vertices_in.size() < 2)
     {
       throw std::runtime_error("At least two vertices are required");
     }
 
-    // TODO: reserve space for vertices?
+    _Parts result{
+      _base::template _to_vector<V>(std::forward<C1>(vertices_in), resource),
+      std::pmr::vector<V>(resource),
+      std::pmr::vector<S>(resource)};
+    auto& vertices = result.vertices;
+    auto& tangents = result.tangents;
+    auto& grid = result.grid;
 
-    vertices.assign(std::begin(vertices_in), std::end(vertices_in));
     if (closed)
     {
-      vertices.push_back(vertices_in[0]);
-      vertices.push_back(vertices_in[1]);
+      vertices.reserve(vertices.size() + 2);
+      vertices.push_back(vertices[0]);
+      vertices.push_back(vertices[1]);
     }
 
     if (tcb.size() + 2 != vertices.size())
@@ -45,38 +278,47 @@ private:
                                "values (except for closed curves)");
     }
 
-    // Create grid with centripetal parametrization
+    // Create grid with centripetal parametrization.
+    // The differences are computed in parallel, the sum sequentially.
 
-    // TODO: reserve space for grid?
-
-    grid.push_back(0);
+    grid.resize(vertices.size());
+    grid[0] = 0;
+    parallel_for(pool, vertices.size() - 1, _base::_chunk_size
+        , [&vertices, &grid](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        grid[i + 1] = std::sqrt(length(vertices[i + 1] - vertices[i]));
+      }
+    });
     for (size_t i = 0; i < vertices.size() - 1; ++i)
     {
-      V x0 = vertices[i];
-      V x1 = vertices[i + 1];
-      auto delta = std::sqrt(length(x1 - x0));
-      if (delta == 0)
+      if (grid[i + 1] == 0)
       {
         throw std::runtime_error("Repeated vertices are not possible");
       }
-      grid.push_back(grid.back() + delta);
+      grid[i + 1] += grid[i];
     }
 
-    // TODO: reserve space for tangents?
-
-    tangents.emplace_back();  // Will be overwritten later
+    // The first tangent will be overwritten later,
+    // one more is added at the end of open curves
+    tangents.reserve(2 * (vertices.size() - 1));
+    tangents.resize(1 + 2 * (vertices.size() - 2));
 
     assert(vertices.size() == grid.size());
     assert(vertices.size() == tcb.size() + 2);
-    for (size_t i = 0; i < vertices.size() - 2; ++i)
-    {
-      auto [incoming, outgoing] = _calculate_tangents(
-          vertices[i], vertices[i + 1], vertices[i + 2],
-          grid[i], grid[i + 1], grid[i + 2],
-          tcb[(i + closed) % tcb.size()]);
-      tangents.push_back(incoming);
-      tangents.push_back(outgoing);
-    }
+    parallel_for(pool, vertices.size() - 2, _base::_chunk_size
+        , [&vertices, &tangents, &grid, &tcb, closed](size_t begin
+                                                     , size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        auto [incoming, outgoing] = _calculate_tangents(
+            vertices[i], vertices[i + 1], vertices[i + 2],
+            grid[i], grid[i + 1], grid[i + 2],
+            tcb[(i + closed) % tcb.size()]);
+        tangents[2 * i + 1] = incoming;
+        tangents[2 * i + 2] = outgoing;
+      }
+    });
 
     if (closed)
     {
@@ -84,7 +326,8 @@ private:
       tangents[0] = tangents.back();
       tangents.pop_back();
 
-      // Remove temporary vertex and grid elements:
+      // Remove temporary vertex and grid elements
+      // (the repeated first vertex is removed later):
       vertices.pop_back();
       grid.pop_back();
     }
@@ -133,12 +376,145 @@ private:
     return {incoming, outgoing};
   }
 
+  /// Index into _tcb for vertex i
+  size_t _tcb_index(size_t i) const
+  {
+    if (_closed)
+    {
+      if (i >= _vertices.size())
+      {
+        throw std::out_of_range("Vertex index out of range");
+      }
+      return i;
+    }
+    if (i < 1 || i >= _vertices.size() - 1)
+    {
+      throw std::out_of_range("TCB values are only allowed for inner "
+                              "vertices of open curves");
+    }
+    return i - 1;
+  }
+
+  /// Re-compute the segments from i - before to i + after - 1
+  /// (clipped or wrapped around, depending on _closed).
+  std::vector<size_t> _update_segments_around(size_t i
+      , size_t before, size_t after)
+  {
+    auto n = _vertices.size();
+    auto segments = this->_grid.size() - 1;
+    std::vector<size_t> result;
+    for (size_t k = i + n - before; k < i + n + after; ++k)
+    {
+      if (_closed)
+      {
+        result.push_back(k % n);
+      }
+      else if (n <= k && k - n < segments)
+      {
+        result.push_back(k - n);
+      }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    for (auto index: result)
+    {
+      _compute_segment(index);
+    }
+    // Pre-computed values are updated for contiguous ranges of segments
+    for (size_t begin = 0; begin < result.size();)
+    {
+      size_t end = begin + 1;
+      while (end < result.size() && result[end] == result[end - 1] + 1)
+      {
+        ++end;
+      }
+      this->_update_segments(result[begin], result[end - 1] + 1);
+      begin = end;
+    }
+    return result;
+  }
+
+  /// Re-compute the segments from "first" to the end (of an open curve).
+  /// Returns their indices.
+  std::vector<size_t> _update_tail(size_t first)
+  {
+    std::vector<size_t> result;
+    for (size_t index = first; index < this->_segments.size(); ++index)
+    {
+      _compute_segment(index);
+      result.push_back(index);
+    }
+    this->_base::_update_tail(first);
+    this->_update_tail_lengths(first);
+    return result;
+  }
+
+  void _compute_segment(size_t index)
+  {
+    auto next = (index + 1) % _vertices.size();
+    this->_segments[index] = _base::_segment(
+        _vertices[index], _vertices[next],
+        std::get<1>(_vertex_tangents(index)),
+        std::get<0>(_vertex_tangents(next)),
+        this->_grid[index + 1] - this->_grid[index]);
+  }
+
+  /// Incoming and outgoing tangent at vertex i, given the current
+  /// vertices and grid.  This must be consistent with _init().
+  std::tuple<V, V> _vertex_tangents(size_t i) const
+  {
+    const auto& grid = this->_grid;
+    auto n = _vertices.size();
+    if (_closed)
+    {
+      if (i == 0)
+      {
+        // Vertex 0 is treated as the (temporary) vertex n in _init()
+        return _calculate_tangents(
+            _vertices[n - 1], _vertices[0], _vertices[1],
+            grid[n - 1], grid[n], grid[n] + grid[1] - grid[0],
+            _tcb[0]);
+      }
+      return _calculate_tangents(
+          _vertices[i - 1], _vertices[i], _vertices[(i + 1) % n],
+          grid[i - 1], grid[i], grid[i + 1],
+          _tcb[i]);
+    }
+    if (n == 2)
+    {
+      // Straight line
+      V tangent = (_vertices[1] - _vertices[0]) / (grid[1] - grid[0]);
+      return {tangent, tangent};
+    }
+    if (i == 0)
+    {
+      V tangent = _end_tangent(_vertices[0], _vertices[1], grid[0], grid[1]
+          , std::get<0>(_vertex_tangents(1)));
+      return {tangent, tangent};
+    }
+    if (i == n - 1)
+    {
+      V tangent = _end_tangent(_vertices[n - 2], _vertices[n - 1]
+          , grid[n - 2], grid[n - 1], std::get<1>(_vertex_tangents(n - 2)));
+      return {tangent, tangent};
+    }
+    return _calculate_tangents(
+        _vertices[i - 1], _vertices[i], _vertices[i + 1],
+        grid[i - 1], grid[i], grid[i + 1],
+        _tcb[i - 1]);
+  }
+
   /// "natural" end conditions
   static V _end_tangent(V x0, V x1, S t0, S t1, V inner_tangent)
   {
     auto delta = t1 - t0;
     return (S(3) * x1 - S(3) * x0 - delta * inner_tangent) / (S(2) * delta);
   }
+
+  std::pmr::vector<V> _vertices;
+  std::pmr::vector<std::array<S, 3>> _tcb;
+  bool _closed;
 };
 
 }  // namespace asdf
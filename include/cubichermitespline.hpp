@@ -1,5 +1,12 @@
 #pragma once
 
+#include <algorithm>  // for adjacent_find()
+#include <functional>  // for greater_equal
+#include <iterator>  // for begin(), end()
+#include <memory_resource>
+#include <tuple>
+#include <utility>  // for forward()
+
 #include "piecewisecubiccurve.hpp"
 
 namespace asdf {
@@ -7,9 +14,32 @@ namespace asdf {
 template<typename S, typename V>
 class CubicHermiteSpline : public PiecewiseCubicCurve<S, V>
 {
+private:
+  using _base = PiecewiseCubicCurve<S, V>;
+
 public:
+  /// If a "pool" is given, segments are computed in parallel.
+  ///
+  /// All vectors are allocated from "resource".  If "grid" is an rvalue
+  /// std::pmr::vector using the same resource, it is moved.
+  template<typename C1, typename C2, typename C3>
+  CubicHermiteSpline(const C1& vertices, const C2& tangents, C3&& grid
+      , WorkerPool* pool = nullptr
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(std::make_from_tuple<_base>(_init(
+          vertices, tangents, std::forward<C3>(grid), pool, resource)))
+  {}
+
+  /// Restore a spline that has been stored with save().
+  explicit CubicHermiteSpline(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(reader, resource)
+  {}
+
+private:
   template<typename C1, typename C2, typename C3>
-  CubicHermiteSpline(const C1& vertices, const C2& tangents, const C3& grid)
+  static auto _init(const C1& vertices, const C2& tangents, C3&& grid
+      , WorkerPool* pool, std::pmr::memory_resource* resource)
   {
     if (vertices.size() < 2)
     {
@@ -30,29 +60,38 @@ public:
       throw std::runtime_error("Grid values must be strictly ascending");
     }
 
-    this->_segments.reserve(segments_size);
-    for (size_t i = 0; i < segments_size; ++i)
-    {
-      auto x0 = vertices[i];
-      auto x1 = vertices[i + 1];
-      auto v0 = tangents[2 * i];
-      auto v1 = tangents[2 * i + 1];
-      auto t0 = grid[i];
-      auto t1 = grid[i + 1];
-      auto delta = t1 - t0;
-
-      // [a0]   [ 1,  0,          0,      0] [x0]
-      // [a1] = [ 0,  0,      delta,      0] [x1]
-      // [a2]   [-3,  3, -2 * delta, -delta] [v0]
-      // [a3]   [ 2, -2,      delta,  delta] [v1]
-
-      this->_segments.push_back({
-                x0                                             ,
-                                        delta * v0             ,
-        -S(3) * x0 + S(3) * x1 - S(2) * delta * v0 - delta * v1,
-         S(2) * x0 - S(2) * x1 +        delta * v0 + delta * v1});
-    }
-    this->_grid.assign(std::begin(grid), std::end(grid));
+    std::tuple<std::pmr::vector<std::array<V, 4>>, std::pmr::vector<S>
+      , WorkerPool*> result{resource, resource, pool};
+    auto& segments = std::get<0>(result);
+
+    segments.resize(segments_size);
+    parallel_for(pool, segments_size, _base::_chunk_size
+        , [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        segments[i] = _segment(vertices[i], vertices[i + 1]
+            , tangents[2 * i], tangents[2 * i + 1], grid[i + 1] - grid[i]);
+      }
+    });
+    std::get<1>(result) = _base::template _to_vector<S>(
+        std::forward<C3>(grid), resource);
+    return result;
+  }
+
+protected:
+  /// Polynomial coefficients of a single segment
+  static std::array<V, 4> _segment(V x0, V x1, V v0, V v1, S delta)
+  {
+    // [a0]   [ 1,  0,          0,      0] [x0]
+    // [a1] = [ 0,  0,      delta,      0] [x1]
+    // [a2]   [-3,  3, -2 * delta, -delta] [v0]
+    // [a3]   [ 2, -2,      delta,  delta] [v1]
+
+    return {
+              x0                                             ,
+                                      delta * v0             ,
+      -S(3) * x0 + S(3) * x1 - S(2) * delta * v0 - delta * v1,
+       S(2) * x0 - S(2) * x1 +        delta * v0 + delta * v1};
   }
 };
 
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>  // for max_element()
+#include <array>
+#include <cmath>  // for abs()
+#include <cstddef>  // for byte
+#include <memory_resource>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+namespace asdf {
+
+using std::size_t;
+
+/// Result of numerical integration.
+template<typename T>
+struct QuadratureResult
+{
+  T value;
+  /// Estimate of the absolute error
+  T error;
+};
+
+/// Gauss-Kronrod quadrature with 15 points (and 7 embedded Gauss points).
+///
+/// https://en.wikipedia.org/wiki/Gauss%E2%80%93Kronrod_quadrature_formula
+///
+/// The result of the 15-point Kronrod rule is returned, the difference to
+/// the 7-point Gauss rule is used as (pessimistic) error estimate.
+/// Nodes and weights are taken from QUADPACK (function qk15).
+template<typename T, typename F>
+QuadratureResult<T> gauss_kronrod15(F f, T a, T b)
+{
+  // Positive Kronrod nodes, every second one is also a Gauss node
+  static constexpr std::array<T, 8> nodes = {
+    T(0.991455371120812639206854697526329L),
+    T(0.949107912342758524526189684047851L),
+    T(0.864864423359769072789712788640926L),
+    T(0.741531185599394439863864773280788L),
+    T(0.586087235467691130294144845693013L),
+    T(0.405845151377397166906606412076961L),
+    T(0.207784955007898467600689403773245L),
+    T(0)};
+  static constexpr std::array<T, 8> kronrod_weights = {
+    T(0.022935322010529224963732008058970L),
+    T(0.063092092629978553290700663189204L),
+    T(0.104790010322250183839876322541518L),
+    T(0.140653259715525918745189590510238L),
+    T(0.169004726639267902826583426598550L),
+    T(0.190350578064785409913256402421014L),
+    T(0.204432940075298892414161999234649L),
+    T(0.209482141084727828012999174891714L)};
+  static constexpr std::array<T, 4> gauss_weights = {
+    T(0.129484966168869693270611432679082L),
+    T(0.279705391489276667901467771423780L),
+    T(0.381830050505118944950369775488975L),
+    T(0.417959183673469387755102040816327L)};
+
+  T center = (a + b) / 2;
+  T half_length = (b - a) / 2;
+  T f_center = f(center);
+  T kronrod = kronrod_weights[7] * f_center;
+  T gauss = gauss_weights[3] * f_center;
+  for (size_t i = 0; i < 7; ++i)
+  {
+    T x = half_length * nodes[i];
+    T sum = f(center - x) + f(center + x);
+    kronrod += kronrod_weights[i] * sum;
+    if (i % 2)
+    {
+      gauss += gauss_weights[i / 2] * sum;
+    }
+  }
+  using std::abs;
+  return {kronrod * half_length, abs((kronrod - gauss) * half_length)};
+}
+
+/// Globally adaptive Gauss-Kronrod quadrature.
+///
+/// Starting with the whole range, the sub-interval with the largest error
+/// estimate is bisected until the sum of all error estimates is at most
+/// "tolerance" or until there are "max_intervals" sub-intervals.
+/// Smooth integrands typically need only one or a few sub-intervals,
+/// irregular ones are only subdivided where necessary.
+///
+/// Up to 64 sub-intervals are stored on the stack, more are allocated
+/// from "resource".
+template<typename T, typename F>
+QuadratureResult<T> adaptive_gauss_kronrod(F f, T a, T b, T tolerance
+    , size_t max_intervals = 50
+    , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+  struct Interval
+  {
+    T a;
+    T b;
+    QuadratureResult<T> result;
+  };
+
+  instrumentation::count(instrumentation::Counter::quadratures);
+  auto first = gauss_kronrod15(f, a, b);
+  if (first.error <= tolerance || max_intervals < 2)
+  {
+    return first;
+  }
+
+  alignas(Interval) std::array<std::byte, 64 * sizeof(Interval)> buffer;
+  std::pmr::monotonic_buffer_resource scratch(
+      buffer.data(), buffer.size(), resource);
+  std::pmr::vector<Interval> intervals(&scratch);
+  intervals.reserve(max_intervals);
+  intervals.push_back({a, b, first});
+  T error = first.error;
+  while (error > tolerance && intervals.size() < max_intervals)
+  {
+    auto worst = std::max_element(intervals.begin(), intervals.end()
+        , [](const Interval& lhs, const Interval& rhs) {
+      return lhs.result.error < rhs.result.error;
+    });
+    T start = worst->a;
+    T end = worst->b;
+    T mid = (start + end) / 2;
+    auto left = gauss_kronrod15(f, start, mid);
+    auto right = gauss_kronrod15(f, mid, end);
+    error += left.error + right.error - worst->result.error;
+    *worst = {start, mid, left};
+    intervals.push_back({mid, end, right});
+  }
+
+  QuadratureResult<T> result{0, 0};
+  for (const auto& interval: intervals)
+  {
+    result.value += interval.result.value;
+    result.error += interval.result.error;
+  }
+  return result;
+}
+
+}  // namespace asdf
@@ -1,36 +1,108 @@
 #pragma once
 
+#include <array>
+#include <utility>  // for pair
+
+#include "instrumentation.hpp"
+
 namespace asdf {
 
-/// Gauss-Legendre quadrature of order 13.
+using std::size_t;
+
+/// Nodes and weights for Gauss-Legendre quadrature of order N.
 ///
 /// https://en.wikipedia.org/wiki/Gaussian_quadrature
 ///
-/// Arrays were generated with scipy.special.roots_legendre(13).
-/// 13th order typically leads to results within single-precision
-/// accuracy [citation needed].
+/// The nodes are the roots of the Legendre polynomial P_N, which are
+/// computed at compile time with Newton's method (in long double precision).
 ///
 /// See also https://pomax.github.io/bezierinfo/legendre-gauss.html
-template<typename F>
-float gauss_legendre13(F f, float a, float b)
+template<size_t N, typename T>
+struct GaussLegendreRule
+{
+  static_assert(N > 0, "Order must be at least 1");
+
+  /// Nodes within (-1, 1) in ascending order
+  std::array<T, N> nodes{};
+  std::array<T, N> weights{};
+
+  constexpr GaussLegendreRule()
+  {
+    using L = long double;
+    const L pi = 3.141592653589793238462643383279502884L;
+    for (size_t i = 0; i < (N + 1) / 2; ++i)
+    {
+      // Initial guess, see Abramowitz and Stegun (1972), eq. 22.16.6
+      L x = _cos(pi * (L(i) + L(0.75)) / (L(N) + L(0.5)));
+      for (int iteration = 0; iteration < 100; ++iteration)
+      {
+        auto [p, dp] = _legendre(x);
+        L next = x - p / dp;
+        if (next == x)
+        {
+          break;
+        }
+        x = next;
+      }
+      L derivative = _legendre(x).second;
+      L weight = 2 / ((1 - x * x) * derivative * derivative);
+      nodes[i] = static_cast<T>(-x);
+      nodes[N - 1 - i] = static_cast<T>(x);
+      weights[i] = static_cast<T>(weight);
+      weights[N - 1 - i] = static_cast<T>(weight);
+    }
+    if (N % 2)
+    {
+      nodes[N / 2] = 0;
+    }
+  }
+
+private:
+  /// Value of P_N(x) and its derivative
+  static constexpr std::pair<long double, long double> _legendre(long double x)
+  {
+    using L = long double;
+    L previous = 1;
+    L current = x;
+    for (size_t k = 1; k < N; ++k)
+    {
+      L next = (L(2 * k + 1) * x * current - L(k) * previous) / L(k + 1);
+      previous = current;
+      current = next;
+    }
+    return {current, L(N) * (x * current - previous) / (x * x - 1)};
+  }
+
+  /// std::cos() is not constexpr, this is only meant for 0 <= x <= pi
+  static constexpr long double _cos(long double x)
+  {
+    long double result = 0;
+    long double term = 1;
+    for (int k = 0; k < 40; ++k)
+    {
+      result += term;
+      term *= -x * x / static_cast<long double>((2 * k + 1) * (2 * k + 2));
+    }
+    return result;
+  }
+};
+
+/// Pre-computed rule, see GaussLegendreRule.
+template<size_t N, typename T>
+inline constexpr GaussLegendreRule<N, T> gauss_legendre_rule{};
+
+/// Gauss-Legendre quadrature of order N of the function f within [a, b].
+///
+/// A rule of order N integrates polynomials up to degree 2 * N - 1 exactly.
+template<size_t N, typename T, typename F>
+T gauss_legendre(F f, T a, T b)
 {
-  std::array<float, 13> times = {
-       -0.9841830547185881f, -0.9175983992229779f , -0.8015780907333099f ,
-       -0.6423493394403403f, -0.44849275103644687f, -0.23045831595513483f,
-        0.f                ,  0.23045831595513483f,  0.44849275103644687f,
-        0.6423493394403403f,  0.8015780907333099f ,  0.9175983992229779f ,
-        0.9841830547185881f};
-  std::array<float, 13> weights = {
-        0.04048400476531615f, 0.0921214998377276f ,  0.1388735102197876f ,
-        0.17814598076194554f, 0.20781604753688862f,  0.2262831802628975f ,
-        0.23255155323087406f, 0.2262831802628975f ,  0.20781604753688862f,
-        0.17814598076194554f, 0.1388735102197876f ,  0.0921214998377276f ,
-        0.04048400476531615f};
-
-  float result = 0;
-  for (size_t i = 0; i < times.size(); ++i)
+  constexpr const auto& rule = gauss_legendre_rule<N, T>;
+  instrumentation::count(instrumentation::Counter::quadratures);
+  T result = 0;
+  for (size_t i = 0; i < N; ++i)
   {
-    result += weights[i] * f((b - a) * times[i] / 2 + (a + b) / 2);
+    result += rule.weights[i] * f((b - a) * rule.nodes[i] / 2 + (a + b) / 2);
   }
   return (b - a) * result / 2;
 }
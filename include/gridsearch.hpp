@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>  // for min(), upper_bound()
+#include <cassert>
+#include <cstdint>
+#include <iterator>  // for begin()
+#include <memory_resource>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+namespace asdf {
+
+using std::size_t;
+
+/// Find the index i of the segment with grid[i] <= value < grid[i + 1].
+///
+/// The search starts at the segment "hint" and exponentially widens the
+/// range in the direction of "value" before doing a binary search.
+/// When subsequent values are close to each other (e.g. when evaluating
+/// sorted values), only a few comparisons are necessary.
+///
+/// Grid values must be sorted in ascending order
+/// and grid.front() <= value < grid.back() must hold.
+/// If there are repeated grid values, the last one of them is used.
+template<typename C, typename T>
+size_t find_segment(const C& grid, T value, size_t hint) noexcept
+{
+  assert(grid.size() >= 2);
+  assert(grid.front() <= value && value < grid.back());
+  instrumentation::count(instrumentation::Counter::segment_lookups);
+  size_t last = grid.size() - 1;
+  if (hint >= last)
+  {
+    hint = last - 1;
+  }
+  // Invariant: grid[lo] <= value < grid[hi] (or hi == last)
+  size_t lo, hi;
+  if (grid[hint] <= value)
+  {
+    lo = hint;
+    hi = hint + 1;
+    size_t step = 1;
+    while (hi < last && grid[hi] <= value)
+    {
+      lo = hi;
+      step *= 2;
+      hi = std::min(lo + step, last);
+    }
+  }
+  else
+  {
+    assert(hint > 0);
+    hi = hint;
+    lo = hint - 1;
+    size_t step = 1;
+    while (lo > 0 && value < grid[lo])
+    {
+      hi = lo;
+      step *= 2;
+      lo = (step < hi) ? hi - step : 0;
+    }
+  }
+  auto first = std::begin(grid);
+  return std::upper_bound(first + lo, first + hi, value) - first - 1;
+}
+
+/// Acceleration structure for finding segments in a sorted grid.
+///
+/// The range of the grid is divided into uniform buckets (as many as
+/// there are segments).  For each bucket, the grid values within it are
+/// stored, which leaves only a small range for the final binary search.
+/// For roughly uniform grids, this takes constant time, in the worst case
+/// (all grid values within one bucket) it's a normal binary search.
+///
+/// The grid itself is not stored, it has to be passed to find().
+/// After any change of the grid values, build() has to be called again.
+/// Alternatively, if values have only been changed (or appended) at the
+/// end of the grid, update() can be used.
+template<typename S>
+class GridIndex
+{
+public:
+  explicit GridIndex(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _ends(resource)
+  {}
+
+  /// Grid values must be sorted in ascending order (repetitions are
+  /// allowed).
+  template<typename C>
+  void build(const C& grid)
+  {
+    assert(grid.size() >= 2);
+    assert(grid.size() <= UINT32_MAX);
+    _origin = grid.front();
+    S range = grid.back() - grid.front();
+    auto buckets = grid.size() - 1;
+    // NB: If all values are the same, everything is in the first bucket
+    _scale = (range > 0) ? S(buckets) / range : S(0);
+    _ends.assign(buckets, 0);
+    for (const auto& value: grid)
+    {
+      ++_ends[_bucket(value)];
+    }
+    std::uint32_t sum = 0;
+    for (auto& end: _ends)
+    {
+      sum += end;
+      end = sum;
+    }
+    _covered = grid.size();
+  }
+
+  /// Update after the grid values starting at index "first" have been
+  /// changed and/or new values have been appended or removed (with the
+  /// same requirements as in build()).
+  ///
+  /// The buckets stay valid for the values before "first" (the others
+  /// are found with find_segment()), they are only re-built once the
+  /// rest of the grid has become larger than that (or if the grid has
+  /// become smaller than it was in build()).  This makes appending (and
+  /// changing a few values at the end) amortized constant time.
+  template<typename C>
+  void update(const C& grid, size_t first)
+  {
+    _covered = std::min(_covered, first);
+    if (_ends.size() >= grid.size() || _covered < 2
+        || grid.size() - _covered > _covered)
+    {
+      this->build(grid);
+    }
+  }
+
+  /// Same as find_segment(), with the same preconditions.
+  /// "grid" must be the same as given to build().
+  template<typename C>
+  size_t find(const C& grid, S value) const noexcept
+  {
+    assert(_ends.size() < grid.size());
+    assert(grid.front() <= value && value < grid.back());
+    if (_covered < grid.size() && grid[_covered - 1] <= value)
+    {
+      // Not covered by the buckets, see update()
+      return find_segment(grid, value, _covered - 1);
+    }
+    instrumentation::count(instrumentation::Counter::segment_lookups);
+    // NB: Rounding errors don't matter, because the bucket is calculated
+    //     in the same (monotonic) way as in build().  All values of
+    //     earlier buckets are smaller and all values of later buckets are
+    //     larger than "value".  Values that have been changed since then
+    //     (see update()) are still larger.
+    auto b = _bucket(value);
+    size_t lo = (b > 0) ? _ends[b - 1] : 0;
+    size_t hi = _ends[b];
+    auto first = std::begin(grid);
+    // The segment starting at lo - 1 (if any) is a valid lower bound,
+    // there is at least one grid value <= value
+    return std::upper_bound(first + lo, first + hi, value) - first - 1;
+  }
+
+  /// Same as above, but the segments "hint" and "hint + 1" are checked
+  /// first.  This is faster when subsequent values are close to each
+  /// other (and it's never much slower).
+  template<typename C>
+  size_t find(const C& grid, S value, size_t hint) const noexcept
+  {
+    assert(grid.front() <= value && value < grid.back());
+    if (hint + 1 < grid.size() && grid[hint] <= value)
+    {
+      if (value < grid[hint + 1])
+      {
+        return hint;
+      }
+      if (hint + 2 < grid.size() && value < grid[hint + 2])
+      {
+        return hint + 1;
+      }
+    }
+    return this->find(grid, value);
+  }
+
+private:
+  size_t _bucket(S value) const noexcept
+  {
+    S x = (value - _origin) * _scale;
+    auto last = _ends.size() - 1;
+    // NB: This is also true for NaN
+    return !(x < S(last)) ? last : (x > 0) ? static_cast<size_t>(x) : 0;
+  }
+
+  S _origin{};
+  /// Buckets per unit
+  S _scale{};
+  /// Number of grid values in all buckets up to (and including) each one
+  std::pmr::vector<std::uint32_t> _ends;
+  /// Number of grid values (from the beginning) that haven't changed since
+  /// build()
+  size_t _covered = 0;
+};
+
+}  // namespace asdf
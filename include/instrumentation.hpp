@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>  // for find(), max()
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace asdf {
+
+/// Optional counters and latency histograms for the evaluation hot paths.
+///
+/// Instrumentation is only compiled in if ASDFSPLINE_INSTRUMENTATION is
+/// defined (e.g. with the CMake option of the same name), otherwise all
+/// functions in this namespace are empty and snapshot() returns zeros.
+/// The macro must have the same value in all translation units.
+///
+/// Each thread writes to its own (thread-local) counters without any
+/// synchronization, snapshot() sums the values of all threads (including
+/// threads that have already finished).
+///
+/// NB: The first use in each thread registers its counters, which locks
+///     a mutex and allocates memory.  Afterwards, counting is real-time
+///     safe.
+namespace instrumentation {
+
+#ifdef ASDFSPLINE_INSTRUMENTATION
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum class Counter : std::size_t
+{
+  /// Calls to AsdfSpline::_s2u() (i.e. arc length to curve parameter)
+  s2u_calls,
+  /// Function evaluations during root finding in _s2u()
+  s2u_iterations,
+  /// Maximum number of iterations in a single _s2u() call
+  s2u_max_iterations,
+  /// Calls to MonotoneCubicSpline::get_time() (and get_times())
+  get_time_calls,
+  /// Function evaluations during root finding in get_time()
+  get_time_iterations,
+  /// Maximum number of iterations in a single get_time() call
+  get_time_max_iterations,
+  /// Calls to gauss_legendre() and adaptive_gauss_kronrod()
+  quadratures,
+  /// Searches for the segment containing a given value (a GridIndex
+  /// lookup only counts if the given hint was wrong)
+  segment_lookups,
+};
+
+inline constexpr std::size_t counter_count = 8;
+
+inline constexpr std::array<const char*, counter_count> counter_names{
+  "s2u_calls",
+  "s2u_iterations",
+  "s2u_max_iterations",
+  "get_time_calls",
+  "get_time_iterations",
+  "get_time_max_iterations",
+  "quadratures",
+  "segment_lookups",
+};
+
+/// Public functions whose latency is measured
+enum class Api : std::size_t
+{
+  evaluate,
+  evaluate_velocity,
+  evaluate_state,
+  evaluate_many,
+  evaluate_velocity_many,
+  render_block,
+  cursor_evaluate,
+  cursor_evaluate_velocity,
+  cursor_evaluate_state,
+  scene_evaluate_all,
+};
+
+inline constexpr std::size_t api_count = 10;
+
+inline constexpr std::array<const char*, api_count> api_names{
+  "evaluate",
+  "evaluate_velocity",
+  "evaluate_state",
+  "evaluate_many",
+  "evaluate_velocity_many",
+  "render_block",
+  "cursor_evaluate",
+  "cursor_evaluate_velocity",
+  "cursor_evaluate_state",
+  "scene_evaluate_all",
+};
+
+/// Latency histograms have logarithmic buckets: bucket 0 counts calls
+/// that took less than 1 ns, bucket i (with i > 0) counts calls that took
+/// between 2^(i - 1) and 2^i - 1 ns, the last bucket also counts all
+/// longer calls.
+inline constexpr std::size_t latency_buckets = 32;
+
+struct Snapshot
+{
+  std::array<std::uint64_t, counter_count> counters{};
+  std::array<std::array<std::uint64_t, latency_buckets>, api_count>
+    latencies{};
+
+  std::uint64_t operator[](Counter counter) const
+  {
+    return counters[static_cast<std::size_t>(counter)];
+  }
+
+  const std::array<std::uint64_t, latency_buckets>& operator[](Api api) const
+  {
+    return latencies[static_cast<std::size_t>(api)];
+  }
+};
+
+namespace detail {
+
+inline bool is_maximum(std::size_t counter)
+{
+  return counter == std::size_t(Counter::s2u_max_iterations)
+      || counter == std::size_t(Counter::get_time_max_iterations);
+}
+
+/// NB: Atomics are only used to avoid data races with snapshot() and
+///     reset(), each value is only incremented by its own thread.
+struct ThreadCounters
+{
+  std::array<std::atomic<std::uint64_t>, counter_count> counters{};
+  std::array<std::array<std::atomic<std::uint64_t>, latency_buckets>
+    , api_count> latencies{};
+
+  void add_to(Snapshot& snapshot) const
+  {
+    for (std::size_t i = 0; i < counter_count; ++i)
+    {
+      auto value = counters[i].load(std::memory_order_relaxed);
+      auto& total = snapshot.counters[i];
+      total = is_maximum(i) ? std::max(total, value) : total + value;
+    }
+    for (std::size_t i = 0; i < api_count; ++i)
+    {
+      for (std::size_t j = 0; j < latency_buckets; ++j)
+      {
+        snapshot.latencies[i][j]
+          += latencies[i][j].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void clear()
+  {
+    for (auto& value: counters)
+    {
+      value.store(0, std::memory_order_relaxed);
+    }
+    for (auto& histogram: latencies)
+    {
+      for (auto& value: histogram)
+      {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+/// Counters of all running threads and the sum of all finished threads
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<ThreadCounters*> threads;
+  Snapshot finished;
+};
+
+inline Registry& registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+/// Registers its counters on construction, and adds them to the
+/// "finished" values when the thread ends
+class ThreadHandle
+{
+public:
+  ThreadHandle()
+  {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(&counters);
+  }
+
+  ThreadHandle(const ThreadHandle&) = delete;
+  ThreadHandle& operator=(const ThreadHandle&) = delete;
+
+  ~ThreadHandle()
+  {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    counters.add_to(r.finished);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &counters));
+  }
+
+  ThreadCounters counters;
+};
+
+inline ThreadCounters& local()
+{
+  thread_local ThreadHandle handle;
+  return handle.counters;
+}
+
+inline void add(std::atomic<std::uint64_t>& value, std::uint64_t n)
+{
+  // No read-modify-write needed, there is only one writing thread
+  value.store(value.load(std::memory_order_relaxed) + n
+      , std::memory_order_relaxed);
+}
+
+}  // namespace detail
+
+/// Increment a counter (or, for maximum values, update the maximum).
+inline void count(Counter counter, std::uint64_t n = 1)
+{
+  if constexpr (enabled)
+  {
+    auto i = static_cast<std::size_t>(counter);
+    auto& value = detail::local().counters[i];
+    if (detail::is_maximum(i))
+    {
+      if (n > value.load(std::memory_order_relaxed))
+      {
+        value.store(n, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      detail::add(value, n);
+    }
+  }
+}
+
+/// Measures the time from construction to destruction and adds it to the
+/// latency histogram of the given function.
+class ScopedLatency
+{
+public:
+  explicit ScopedLatency(Api api)
+  {
+    if constexpr (enabled)
+    {
+      _api = static_cast<std::size_t>(api);
+      _start = _clock::now();
+    }
+  }
+
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+  ~ScopedLatency()
+  {
+    if constexpr (enabled)
+    {
+      auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            _clock::now() - _start).count(), 0));
+      std::size_t bucket = 0;
+      while (bucket < latency_buckets - 1 && (ns >> bucket))
+      {
+        ++bucket;
+      }
+      detail::add(detail::local().latencies[_api][bucket], 1);
+    }
+  }
+
+private:
+  using _clock = std::chrono::steady_clock;
+
+  std::size_t _api = 0;
+  _clock::time_point _start;
+};
+
+/// Sum of the counters of all threads since the last reset().
+inline Snapshot snapshot()
+{
+  Snapshot result;
+  if constexpr (enabled)
+  {
+    auto& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    result = r.finished;
+    for (const auto* counters: r.threads)
+    {
+      counters->add_to(result);
+    }
+  }
+  return result;
+}
+
+/// Set the counters of all threads to zero.
+///
+/// NB: Increments in other threads during the reset might get lost
+///     (or might survive it).
+inline void reset()
+{
+  if constexpr (enabled)
+  {
+    auto& r = detail::registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.finished = {};
+    for (auto* counters: r.threads)
+    {
+      counters->clear();
+    }
+  }
+}
+
+}  // namespace instrumentation
+
+}  // namespace asdf
@@ -1,9 +1,17 @@
 #pragma once
 
-#include <algorithm>
+#include <algorithm>  // for is_sorted()
+#include <iterator>  // for begin(), end()
+#include <limits>  // for numeric_limits
+#include <memory_resource>
+#include <stdexcept>  // for invalid_argument, out_of_range
+#include <type_traits>  // for enable_if_t, is_pointer_v
+#include <utility>  // for forward()
 
 #include "shapepreservingcubicspline.hpp"
-#include "bisect.hpp"
+#include "gridsearch.hpp"
+#include "instrumentation.hpp"
+#include "newton.hpp"
 
 namespace asdf {
 
@@ -11,16 +19,58 @@ namespace asdf {
 template<typename S>
 class MonotoneCubicSpline : public ShapePreservingCubicSpline<S>
 {
+private:
+  using _base = ShapePreservingCubicSpline<S>;
+
 public:
-  template<typename C, typename... Args>
-  MonotoneCubicSpline(C&& values, Args&&... args)
-  : ShapePreservingCubicSpline<S>(values, std::forward<Args>(args)..., false)
-  , _values(std::forward<C>(values))
+  /// All vectors are allocated from "resource".  If "values" is an rvalue
+  /// std::pmr::vector using the same resource, it is moved (instead of
+  /// being copied).
+  template<typename C1, typename C2>
+  MonotoneCubicSpline(C1&& values, const C2& grid
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(values, grid, false, resource)
+  , _values(_base::template _to_vector<S>(std::forward<C1>(values), resource))
+  , _values_index(resource)
   {
-    if (!std::is_sorted(std::begin(_values), std::end(_values)))
+    _check_values();
+    _values_index.build(_values);
+  }
+
+  /// Same as above, with given slopes (std::nullopt for automatic ones).
+  template<typename C1, typename C2, typename C3
+    , typename = std::enable_if_t<!std::is_pointer_v<C3>>>
+  MonotoneCubicSpline(C1&& values, const C2& slopes, const C3& grid
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(values, slopes, grid, false, resource)
+  , _values(_base::template _to_vector<S>(std::forward<C1>(values), resource))
+  , _values_index(resource)
+  {
+    _check_values();
+    _values_index.build(_values);
+  }
+
+  /// Restore a spline that has been stored with save().
+  explicit MonotoneCubicSpline(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(reader, resource)
+  , _values(resource)
+  , _values_index(resource)
+  {
+    reader.read(_values);
+    if (_values.size() != this->_grid.size()
+        || !is_finite_and_ascending(_values.begin(), _values.end(), false))
     {
-      throw std::invalid_argument("Values must be increasing");
+      throw std::runtime_error("Invalid binary data for monotone spline");
     }
+    _values_index.build(_values);
+  }
+
+  /// Store everything that's needed to restore the spline.
+  void save(BinaryWriter<S>& writer) const
+  {
+    _base::save(writer);
+    writer.write(_values);
   }
 
   /// Get the time instance for the given value.
@@ -28,50 +78,157 @@ public:
   /// If "value" is outside of the range, the first/last time is returned.
   // TODO: rename to something with "solve"?
   std::optional<S> get_time(S value) const
+  {
+    size_t index = 0;
+    return _get_time(value, index);
+  }
+
+  /// Get the time instances for all values in [first, last) and write
+  /// them (as std::optional<S>) to "result", see get_time().
+  /// Returns the iterator past the last written element.
+  ///
+  /// The segment of the previous value (and the next one) is checked
+  /// first, which is faster than calling get_time() repeatedly if the
+  /// values are sorted.
+  template<typename InputIt, typename OutputIt>
+  OutputIt get_times(InputIt first, InputIt last, OutputIt result) const
+  {
+    size_t index = 0;
+    for (; first != last; ++first, ++result)
+    {
+      *result = _get_time(*first, index);
+    }
+    return result;
+  }
+
+  /// Replace the knots from index "first" to the end with the given
+  /// values, slopes (std::nullopt for automatic ones) and grid values.
+  /// Their number may be different, e.g. to append knots.
+  ///
+  /// The knots before "first + 3" must be the same as before (except if
+  /// "first" is zero), because their slopes are not re-computed.
+  /// Only the segments after knot "first" (all if it's zero) are
+  /// re-computed, the cost doesn't depend on the number of unchanged knots
+  /// (amortized).
+  /// If this throws, the spline is not modified.
+  template<typename C1, typename C2, typename C3>
+  void update_tail(size_t first, const C1& values, const C2& slopes
+      , const C3& grid)
+  {
+    if (first > _values.size() || values.size() < 2
+        || (first > 0 && values.size() < 3))
+    {
+      throw std::out_of_range("Invalid range of knots");
+    }
+    if (!std::is_sorted(std::begin(values), std::end(values))
+        || (first > 0 && *std::begin(values) < _values[first - 1]))
+    {
+      throw std::invalid_argument("Values must be increasing");
+    }
+    this->_replace_tail(first, values, slopes, grid);
+    _values.resize(first);
+    _values.insert(_values.end(), std::begin(values), std::end(values));
+    _values_index.update(_values, first);
+  }
+
+  /// Remove the first "count" knots.  "offset" is subtracted from all
+  /// remaining values.
+  ///
+  /// The remaining segments are not re-computed, even though the slope of
+  /// the new first knot would be different in a new spline.
+  void erase_front(size_t count, S offset = 0)
+  {
+    if (count + 2 > _values.size())
+    {
+      throw std::out_of_range("At least two knots must remain");
+    }
+    this->_erase_front(count);
+    for (auto& a: this->_segments)
+    {
+      a[0] -= offset;
+    }
+    _values.erase(_values.begin(), _values.begin() + count);
+    for (auto& value: _values)
+    {
+      value -= offset;
+    }
+    _values_index.build(_values);
+  }
+
+private:
+  void _check_values() const
+  {
+    if (!std::is_sorted(std::begin(_values), std::end(_values)))
+    {
+      throw std::invalid_argument("Values must be increasing");
+    }
+  }
+
+  /// The segment "index" (and the next one) is checked first,
+  /// "index" is updated.
+  std::optional<S> _get_time(S value, size_t& index) const
   {
     // NB: If initially given values are monotone (which we checked above!),
     // repetitions (i.e. a plateau) can only occur at those exact values.
+    instrumentation::count(instrumentation::Counter::get_time_calls);
 
-    auto [beginmatch, endmatch] =
-      std::equal_range(_values.begin(), _values.end(), value);
-
-    if (endmatch == _values.begin())
+    if (value < _values.front())
     {
       // Value too small
       return this->_grid.front();
     }
-    else if (beginmatch == _values.end())
+    else if (value < _values.back())
+    {
+      index = _values_index.find(_values, value, index);
+    }
+    else if (value == _values.back())
+    {
+      index = _values.size() - 1;
+    }
+    else
     {
       // Value too large
       return this->_grid.back();
     }
-    else if (endmatch - beginmatch == 1)
+
+    if (_values[index] == value)
     {
+      if (index > 0 && _values[index - 1] == value)
+      {
+        // Multiple matches
+        return std::nullopt;
+      }
       // Exactly one match
-      return this->_grid[beginmatch - _values.begin()];
-    }
-    else if (endmatch - beginmatch > 1)
-    {
-      // Multiple matches
-      return std::nullopt;
+      return this->_grid[index];
     }
 
-    auto idx = endmatch - _values.begin() - 1;
-    auto a = this->_segments[idx];
+    auto a = this->_segments[index];
     a[0] -= value;
     auto func = [&a](S t) {
-      return ((a[3] * t + a[2]) * t + a[1]) * t + a[0];
+      return std::tuple{
+        ((a[3] * t + a[2]) * t + a[1]) * t + a[0],
+        (3 * a[3] * t + 2 * a[2]) * t + a[1],
+        6 * a[3] * t + 2 * a[2]};
     };
-    // TODO: proper tolerance value
-    S time = bisect(func, S(0), S(1), S(0.0001), 500);
+    S guess = (value - _values[index]) / (_values[index + 1] - _values[index]);
+    // NB: Halley's method typically converges within very few iterations,
+    //     the bisection fallback needs at most about as many iterations as
+    //     there are bits in the mantissa of S.
+    auto result = newton(func, guess, S(0), S(1)
+        , std::numeric_limits<S>::epsilon(), 100);
+    instrumentation::count(
+        instrumentation::Counter::get_time_iterations, result.calls);
+    instrumentation::count(
+        instrumentation::Counter::get_time_max_iterations, result.calls);
+    S time = result.x;
     assert(0 <= time && time <= 1);
-    S t0 = this->_grid[idx];
-    S t1 = this->_grid[idx + 1];
+    S t0 = this->_grid[index];
+    S t1 = this->_grid[index + 1];
     return time * (t1 - t0) + t0;
   }
 
-private:
-  std::vector<S> _values;
+  std::pmr::vector<S> _values;
+  GridIndex<S> _values_index;
 };
 
 }  // namespace asdf
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cassert>
+#include <tuple>  // for tuple_size_v, get()
+
+namespace asdf {
+
+using std::size_t;
+
+/// Result of a root finding algorithm.
+template<typename T>
+struct RootResult
+{
+  /// Approximation of the root
+  T x;
+  /// Function value at the last evaluated point, which is at most
+  /// the given tolerance away from x
+  T residual;
+  /// Number of function calls
+  size_t calls;
+};
+
+/// Newton's method (or Halley's method) safeguarded by bisection.
+///
+/// https://en.wikipedia.org/wiki/Newton%27s_method
+/// https://en.wikipedia.org/wiki/Halley%27s_method
+///
+/// f(x) has to return a std::pair of the function value and its first
+/// derivative.  If it returns a std::tuple with the second derivative as
+/// third element, Halley's method is used.
+///
+/// The root is assumed to be within [xmin, xmax], with f(xmin) <= 0 and
+/// f(xmax) >= 0 (e.g. for increasing functions), but f is never evaluated
+/// at xmin or xmax unless this is requested via "x0".
+/// Whenever a step would leave the current bracket (or the derivative is
+/// zero), bisection is used instead.
+///
+/// Iteration stops when a step is smaller than "xtol" (this last step is
+/// still applied to x, but f is not evaluated there anymore), when the
+/// bracket is smaller than "xtol" or when "max_calls" is reached.
+template<typename T, typename F>
+RootResult<T> newton(F f, T x0, T xmin, T xmax, T xtol, size_t max_calls)
+{
+  assert(xmin <= xmax);
+  assert(max_calls > 0);
+  T x = (x0 < xmin) ? xmin : (xmax < x0) ? xmax : x0;
+  RootResult<T> result{x, T(0), 0};
+  while (result.calls < max_calls)
+  {
+    auto values = f(x);
+    ++result.calls;
+    result.x = x;
+    result.residual = std::get<0>(values);
+    T fx = result.residual;
+    T dfx = std::get<1>(values);
+    if (fx == 0)
+    {
+      break;
+    }
+    else if (fx < 0)
+    {
+      xmin = x;
+    }
+    else
+    {
+      xmax = x;
+    }
+    if (xmax - xmin <= xtol)
+    {
+      break;
+    }
+
+    T step;
+    if constexpr (std::tuple_size_v<decltype(values)> > 2)
+    {
+      T d2fx = std::get<2>(values);
+      step = 2 * fx * dfx / (2 * dfx * dfx - fx * d2fx);
+    }
+    else
+    {
+      step = fx / dfx;
+    }
+    T next = x - step;
+    if (-xtol <= step && step <= xtol)
+    {
+      // NB: The step might be below the resolution of T
+      if (xmin <= next && next <= xmax)
+      {
+        result.x = next;
+      }
+      break;
+    }
+    // NB: This is also true for NaN (e.g. if the derivative is zero)
+    if (!(xmin < next && next < xmax))
+    {
+      next = (xmin + xmax) / 2;
+      if (next == xmin || next == xmax)
+      {
+        break;
+      }
+    }
+    x = next;
+  }
+  return result;
+}
+
+}  // namespace asdf
@@ -1,11 +1,20 @@
 #pragma once
 
-#include <algorithm>  // for upper_bound()
 #include <array>
 #include <cassert>
+#include <iterator>  // for begin(), end()
+#include <memory_resource>
+#include <stdexcept>  // for runtime_error
+#include <type_traits>  // for decay_t, is_lvalue_reference_v
+#include <utility>  // for move(), forward()
 #include <vector>
 
+#include "binaryformat.hpp"
+#include "gauss-kronrod.hpp"
 #include "gauss-legendre.hpp"
+#include "gridsearch.hpp"
+#include "instrumentation.hpp"
+#include "workerpool.hpp"
 
 namespace asdf {
 
@@ -15,56 +24,482 @@ template<typename S, typename V>
 class PiecewiseCubicCurve
 {
 public:
-  // NB: Base class ctor has to correctly populate _segments and _grid
+  /// Each segment holds the polynomial coefficients (starting with the
+  /// constant term) w.r.t. a parameter that is normalized to the range
+  /// [0, 1] within the segment.
+  ///
+  /// If a "pool" is given, per-segment values are computed in parallel.
+  ///
+  /// All pre-computed values are allocated from the memory resource
+  /// of "segments".
+  PiecewiseCubicCurve(std::pmr::vector<std::array<V, 4>> segments
+      , std::pmr::vector<S> grid, WorkerPool* pool = nullptr)
+  : _segments(std::move(segments))
+  , _grid(std::move(grid), _segments.get_allocator())
+  , _velocity_segments(_segments.get_allocator())
+  , _inverse_durations(_segments.get_allocator())
+  , _sub_lengths(_segments.get_allocator())
+  , _cumulative_lengths(_segments.get_allocator())
+  , _grid_index(_segments.get_allocator().resource())
+  {
+    if (_segments.size() < 1)
+    {
+      throw std::runtime_error("At least 1 segment is needed");
+    }
+    if (_segments.size() + 1 != _grid.size())
+    {
+      throw std::runtime_error(
+          "There must be one more grid value than segments");
+    }
 
-  V evaluate(S t) const
+    _precompute_all(pool);
+  }
+
+  /// Restore a curve that has been stored with save().
+  /// Pre-computed arc lengths (if any) are restored as well.
+  explicit PiecewiseCubicCurve(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _segments(resource)
+  , _grid(resource)
+  , _velocity_segments(resource)
+  , _inverse_durations(resource)
+  , _sub_lengths(resource)
+  , _cumulative_lengths(resource)
+  , _grid_index(resource)
   {
-    auto [t0, t1, a] = _get_segment_and_trim(t);
-    t = (t - t0) / (t1 - t0);
-    return ((a[3] * t + a[2]) * t + a[1]) * t + a[0];
+    reader.read(_segments);
+    reader.read(_grid);
+    reader.read(_sub_lengths);
+    reader.read(_cumulative_lengths);
+    if (_segments.size() < 1
+        || _segments.size() + 1 != _grid.size()
+        || !is_finite_and_ascending(_grid.begin(), _grid.end(), true)
+        || (_sub_lengths.size() != _segments.size() * _sub_intervals
+          && !_sub_lengths.empty())
+        || _cumulative_lengths.size() != (_sub_lengths.empty() ? 0
+                                                             : _grid.size())
+        || !_valid_lengths())
+    {
+      throw std::runtime_error("Invalid binary data for curve");
+    }
+    _precompute_all(nullptr);
+  }
+
+  /// Store segments, grid and pre-computed arc lengths, see BinaryFormat.
+  /// Other pre-computed values are cheap to re-compute.
+  void save(BinaryWriter<S>& writer) const
+  {
+    writer.write(_segments);
+    writer.write(_grid);
+    writer.write(_sub_lengths);
+    writer.write(_cumulative_lengths);
+  }
+
+  /// Evaluation functions (including the ones below that take an index)
+  /// don't allocate memory and don't throw.
+  V evaluate(S t) const noexcept
+  {
+    auto index = _get_segment_and_trim(t);
+    return _segment_evaluate(index, t);
+  }
+
+  V evaluate_velocity(S t) const noexcept
+  {
+    auto index = _get_segment_and_trim(t);
+    return _segment_velocity(index, t);
+  }
+
+  /// Same as evaluate(S), but the segment "index" (and the next one) is
+  /// checked first.  Afterwards, "index" holds the segment that contains t.
+  /// This is faster when subsequent calls use nearby values of t.
+  V evaluate(S t, size_t& index) const noexcept
+  {
+    index = _get_segment_and_trim(t, index);
+    return _segment_evaluate(index, t);
   }
 
-  V evaluate_velocity(S t) const
+  /// Same as evaluate_velocity(S), see evaluate(S, size_t&).
+  V evaluate_velocity(S t, size_t& index) const noexcept
   {
-    auto [t0, t1, coeffs] = _get_segment_and_trim(t);
-    return _segment_velocity(t0, t1, coeffs, t);
+    index = _get_segment_and_trim(t, index);
+    return _segment_velocity(index, t);
+  }
+
+  /// Position, velocity and acceleration at t, with a single segment
+  /// lookup.  Position and velocity are the same as with evaluate() and
+  /// evaluate_velocity().
+  std::array<V, 3> evaluate_derivatives(S t) const noexcept
+  {
+    auto index = _get_segment_and_trim(t);
+    return _segment_derivatives(index, t);
+  }
+
+  /// Same as evaluate_derivatives(S), see evaluate(S, size_t&).
+  std::array<V, 3> evaluate_derivatives(S t, size_t& index) const noexcept
+  {
+    index = _get_segment_and_trim(t, index);
+    return _segment_derivatives(index, t);
+  }
+
+  /// Evaluate at all values in [first, last) and write them to "result".
+  /// Returns the iterator past the last written element.
+  /// This is fastest if the values are sorted.
+  template<typename InputIt, typename OutputIt>
+  OutputIt evaluate_many(InputIt first, InputIt last, OutputIt result) const
+  {
+    size_t index = 0;
+    for (; first != last; ++first, ++result)
+    {
+      *result = evaluate(*first, index);
+    }
+    return result;
+  }
+
+  /// Like evaluate_many(), but for velocities.
+  template<typename InputIt, typename OutputIt>
+  OutputIt evaluate_velocity_many(InputIt first, InputIt last
+      , OutputIt result) const
+  {
+    size_t index = 0;
+    for (; first != last; ++first, ++result)
+    {
+      *result = evaluate_velocity(*first, index);
+    }
+    return result;
   }
 
   /// Read-only access
   auto& grid() const { return _grid; }
 
+  /// Polynomial coefficients of all segments (read-only)
+  auto& segments() const { return _segments; }
+
+  /// Velocity within the given segment.
+  /// This is different from evaluate_velocity() at the end points of
+  /// segments (if the curve is not continuously differentiable there).
+  V segment_velocity(size_t index, S t) const noexcept
+  {
+    assert(index < _segments.size());
+    assert(_grid[index] <= t && t <= _grid[index + 1]);
+    return _segment_velocity(index, t);
+  }
+
+  /// Arc length of the given segment.
+  ///
+  /// The template parameter selects the order of Gauss-Legendre quadrature,
+  /// 13th order typically leads to results within single-precision
+  /// accuracy [citation needed].
+  template<size_t Order = 13>
   S segment_length(size_t index) const
   {
     S t0 = _grid.at(index);
     S t1 = _grid.at(index + 1);
-    return this->segment_length(index, t0, t1);
+    return this->template segment_length<Order>(index, t0, t1);
   }
 
+  /// Arc length of the given segment between the parameters a and b.
+  template<size_t Order = 13>
   S segment_length(size_t index, S a, S b) const
   {
-    const auto& coeffs = _segments.at(index);
     assert(a <= b);
+    assert(_grid.at(index) <= a);
+    assert(b <= _grid.at(index + 1));
+
+    auto speed = [this, index](S t) {
+      return length(_segment_velocity(index, t));
+    };
+
+    return gauss_legendre<Order>(speed, a, b);
+  }
+
+  /// Arc length from the beginning of the curve to the beginning of
+  /// segment i (with 0 <= i <= number of segments).
+  /// This is only available if lengths have been pre-computed.
+  S cumulative_length(size_t i) const noexcept
+  {
+    assert(i < _cumulative_lengths.size());
+    return _cumulative_lengths[i];
+  }
+
+  /// Arc length of the given segment from its beginning up to t.
+  ///
+  /// If lengths have been pre-computed, only the part between t and the
+  /// preceding sub-interval boundary has to be integrated (with a lower
+  /// order, since it's shorter).  At the end of the segment, the result
+  /// is consistent with cumulative_length().
+  ///
+  /// This doesn't throw, the index is only checked with assert().
+  S segment_length_to(size_t index, S t) const noexcept
+  {
+    assert(index < _segments.size());
+    S t0 = _grid[index];
+    S t1 = _grid[index + 1];
+    assert(t0 <= t && t <= t1);
+    if (_sub_lengths.empty())
+    {
+      return this->segment_length(index, t0, t);
+    }
+    if (t1 <= t)
+    {
+      return _sub_lengths[(index + 1) * _sub_intervals - 1];
+    }
+    auto knot_time = [t0, t1](size_t k) {
+      return t0 + (t1 - t0) * S(k) / S(_sub_intervals);
+    };
+    auto k = static_cast<size_t>(
+        (t - t0) * _inverse_durations[index] * S(_sub_intervals));
+    if (k >= _sub_intervals)
+    {
+      k = _sub_intervals - 1;
+    }
+    if (k > 0 && t < knot_time(k))
+    {
+      --k;  // Because of rounding errors
+    }
+    S result = (k > 0) ? _sub_lengths[index * _sub_intervals + k - 1] : 0;
+    auto speed = [this, index](S u) {
+      return length(_segment_velocity(index, u));
+    };
+    return result + gauss_legendre<_remainder_order>(speed, knot_time(k), t);
+  }
+
+  /// Arc length of the given segment between the parameters a and b.
+  ///
+  /// If b is at most one sub-interval (see segment_length_to()) away
+  /// from a, this needs only one low-order quadrature (of even lower
+  /// order for very short intervals), which makes it cheap for sweeping
+  /// along a segment in small steps.
+  ///
+  /// This doesn't throw, the index is only checked with assert().
+  S segment_length_between(size_t index, S a, S b) const noexcept
+  {
+    assert(index < _segments.size());
+    assert(_grid[index] <= a && a <= b && b <= _grid[index + 1]);
+    auto speed = [this, index](S u) {
+      return length(_segment_velocity(index, u));
+    };
+    S sub_intervals = (b - a) * _inverse_durations[index] * S(_sub_intervals);
+    if (sub_intervals * S(_short_fraction) <= 1)
+    {
+      return gauss_legendre<_short_order>(speed, a, b);
+    }
+    if (sub_intervals <= 1)
+    {
+      return gauss_legendre<_remainder_order>(speed, a, b);
+    }
+    if (_sub_lengths.empty())
+    {
+      return this->segment_length(index, a, b);
+    }
+    return segment_length_to(index, b) - segment_length_to(index, a);
+  }
+
+  /// Arc length of the given segment with adaptive Gauss-Kronrod
+  /// quadrature, see adaptive_gauss_kronrod().
+  QuadratureResult<S> adaptive_segment_length(size_t index, S tolerance
+      , size_t max_intervals = 50) const
+  {
     S t0 = _grid.at(index);
     S t1 = _grid.at(index + 1);
-    assert(t0 <= a);
-    assert(b <= t1);
+    return this->adaptive_segment_length(
+        index, t0, t1, tolerance, max_intervals);
+  }
+
+  /// Arc length of the given segment between the parameters a and b,
+  /// with adaptive Gauss-Kronrod quadrature.
+  QuadratureResult<S> adaptive_segment_length(size_t index, S a, S b
+      , S tolerance, size_t max_intervals = 50) const
+  {
+    assert(a <= b);
+    assert(_grid.at(index) <= a);
+    assert(b <= _grid.at(index + 1));
 
-    auto speed = [&](S t) {
-      return length(_segment_velocity(t0, t1, coeffs, t));
+    auto speed = [this, index](S t) {
+      return length(_segment_velocity(index, t));
     };
 
-    static_assert(std::is_same_v<S, float>
-        , "For now, this only works with float");
-    return gauss_legendre13(speed, a, b);
+    return adaptive_gauss_kronrod(speed, a, b, tolerance, max_intervals);
   }
 
 protected:
-  std::vector<std::array<V, 4>> _segments;
-  std::vector<S> _grid;
+  /// Pre-compute the arc lengths of all segments (and of a few
+  /// sub-intervals within each segment).
+  ///
+  /// If a "pool" is given, the segments are integrated in parallel.
+  /// The cumulative sum is always computed sequentially, therefore the
+  /// results don't depend on the number of threads.
+  void _compute_lengths(WorkerPool* pool = nullptr)
+  {
+    _sub_lengths.resize(_segments.size() * _sub_intervals);
+    _cumulative_lengths.resize(_segments.size() + 1);
+    parallel_for(pool, _segments.size(), _chunk_size
+        , [this](size_t begin, size_t end) {
+      for (size_t index = begin; index < end; ++index)
+      {
+        _compute_sub_lengths(index);
+      }
+    });
+    _accumulate_lengths(0);
+  }
+
+  /// Re-compute pre-computed values of the segments [first, last),
+  /// after they have been modified by a derived class.
+  ///
+  /// Grid values of later segments may have been shifted (without
+  /// changing their durations), the cumulative lengths of all later
+  /// segments are updated (without integrating them again).
+  void _update_segments(size_t first, size_t last)
+  {
+    assert(first <= last && last <= _segments.size());
+    _grid_index.build(_grid);
+    for (size_t index = first; index < last; ++index)
+    {
+      _precompute(index);
+      if (!_sub_lengths.empty())
+      {
+        _compute_sub_lengths(index);
+      }
+    }
+    if (!_cumulative_lengths.empty())
+    {
+      _accumulate_lengths(first);
+    }
+  }
+
+  /// Change the number of segments (and grid values), e.g. to append
+  /// segments at the end.  New segments and grid values have to be set by
+  /// the derived class, before calling _update_tail().
+  void _resize_segments(size_t size)
+  {
+    assert(size >= 1);
+    _segments.resize(size);
+    _grid.resize(size + 1);
+    _velocity_segments.resize(size);
+    _inverse_durations.resize(size);
+    if (_has_lengths())
+    {
+      _sub_lengths.resize(size * _sub_intervals);
+      _cumulative_lengths.resize(size + 1);
+    }
+  }
+
+  /// Re-compute pre-computed values of the segments from "first" to the
+  /// end, after they have been modified (or appended) by a derived class.
+  /// Arc lengths (if any) have to be updated with _update_tail_lengths().
+  ///
+  /// Unlike _update_segments(), grid values before "first + 1" must not
+  /// have been changed.  The grid index is only updated (see
+  /// GridIndex::update()), therefore the cost doesn't depend on the number
+  /// of unchanged segments (amortized).
+  void _update_tail(size_t first)
+  {
+    assert(first < _segments.size());
+    _grid_index.update(_grid, first + 1);
+    for (size_t index = first; index < _segments.size(); ++index)
+    {
+      _precompute(index);
+    }
+  }
+
+  /// Re-compute the arc lengths of the segments from "first" to the end
+  /// (lengths must have been pre-computed before).
+  void _update_tail_lengths(size_t first)
+  {
+    assert(_has_lengths());
+    for (size_t index = first; index < _segments.size(); ++index)
+    {
+      _compute_sub_lengths(index);
+    }
+    _accumulate_lengths(first);
+  }
+
+  /// Remove the first "count" segments (and grid values).
+  /// The remaining segments are not changed, cumulative lengths start
+  /// at zero again.
+  void _erase_front(size_t count)
+  {
+    assert(count < _segments.size());
+    auto erase = [count](auto& values, size_t per_segment = 1) {
+      values.erase(values.begin(), values.begin() + count * per_segment);
+    };
+    erase(_segments);
+    erase(_grid);
+    erase(_velocity_segments);
+    erase(_inverse_durations);
+    if (_has_lengths())
+    {
+      erase(_sub_lengths, _sub_intervals);
+      erase(_cumulative_lengths);
+      S offset = _cumulative_lengths.front();
+      for (auto& value: _cumulative_lengths)
+      {
+        value -= offset;
+      }
+    }
+    _grid_index.build(_grid);
+  }
+
+  bool _has_lengths() const { return !_cumulative_lengths.empty(); }
+
+  /// Check lengths from BinaryReader, within each segment and cumulative
+  /// ones must start at zero and must be finite and ascending.
+  bool _valid_lengths() const
+  {
+    if (!_has_lengths())
+    {
+      return true;
+    }
+    if (_cumulative_lengths[0] != 0 || !is_finite_and_ascending(
+          _cumulative_lengths.begin(), _cumulative_lengths.end(), false))
+    {
+      return false;
+    }
+    for (size_t index = 0; index < _segments.size(); ++index)
+    {
+      auto first = _sub_lengths.begin() + index * _sub_intervals;
+      if (!(*first >= 0)
+          || !is_finite_and_ascending(first, first + _sub_intervals, false))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Memory resource used for all vectors
+  std::pmr::memory_resource* _resource() const
+  {
+    return _segments.get_allocator().resource();
+  }
+
+  /// Copy a container into a vector that uses "resource".  If "values"
+  /// is an rvalue of such a vector already, it is moved instead
+  /// (which doesn't allocate if it uses the same resource).
+  template<typename T, typename C>
+  static std::pmr::vector<T> _to_vector(C&& values
+      , std::pmr::memory_resource* resource)
+  {
+    if constexpr (std::is_same_v<std::decay_t<C>, std::pmr::vector<T>>
+        && !std::is_lvalue_reference_v<C>)
+    {
+      return std::pmr::vector<T>(std::forward<C>(values), resource);
+    }
+    else
+    {
+      return std::pmr::vector<T>(
+          std::begin(values), std::end(values), resource);
+    }
+  }
+
+  /// Number of segments (or vertices) per chunk for parallel computations
+  static constexpr size_t _chunk_size = 1024;
+
+  std::pmr::vector<std::array<V, 4>> _segments;
+  std::pmr::vector<S> _grid;
 
 private:
   // If t is out of bounds, it is trimmed to the smallest/largest possible value
-  auto _get_segment_and_trim(S& t) const
+  size_t _get_segment_and_trim(S& t) const noexcept
   {
     assert(_grid.size() >= 2);
     size_t idx;
@@ -75,7 +510,7 @@ private:
     }
     else if (t < _grid.back())
     {
-      idx = std::upper_bound(_grid.begin(), _grid.end(), t) - _grid.begin() - 1;
+      idx = _grid_index.find(_grid, t);
     }
     else if (t == _grid.back())
     {
@@ -88,14 +523,155 @@ private:
       idx = _segments.size() - 1;
     }
     assert(idx < _segments.size());
-    return std::tuple{_grid[idx], _grid[idx + 1], _segments[idx]};
+    return idx;
   }
 
-  static V _segment_velocity(S t0, S t1, const std::array<V, 4>& a, S t)
+  // Same as above, but the segment "idx" (and the next one) is checked first
+  size_t _get_segment_and_trim(S& t, size_t idx) const noexcept
   {
-    t = (t - t0) / (t1 - t0);
-    return ((S(3) * a[3] * t + S(2) * a[2]) * t + a[1]) / (t1 - t0);
+    assert(_grid.size() >= 2);
+    assert(_segments.size() >= 1);
+    if (t < _grid.front())
+    {
+      t = _grid.front();
+      idx = 0;
+    }
+    else if (t < _grid.back())
+    {
+      idx = _grid_index.find(_grid, t, idx);
+    }
+    else
+    {
+      t = _grid.back();
+      idx = _segments.size() - 1;
+    }
+    assert(idx < _segments.size());
+    return idx;
+  }
+
+  void _precompute_all(WorkerPool* pool)
+  {
+    _grid_index.build(_grid);
+    _inverse_durations.resize(_segments.size());
+    _velocity_segments.resize(_segments.size());
+    parallel_for(pool, _segments.size(), _chunk_size
+        , [this](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+      {
+        _precompute(i);
+      }
+    });
   }
+
+  /// Pre-computed values to avoid divisions and multiplications
+  /// when evaluating the velocity
+  void _precompute(size_t index)
+  {
+    S inverse_duration = S(1) / (_grid[index + 1] - _grid[index]);
+    const auto& a = _segments[index];
+    _inverse_durations[index] = inverse_duration;
+    _velocity_segments[index] = {
+               inverse_duration * a[1],
+        S(2) * inverse_duration * a[2],
+        S(3) * inverse_duration * a[3]};
+  }
+
+  /// Sub-interval lengths are integrated adaptively (see
+  /// adaptive_gauss_kronrod()), which makes them accurate even for
+  /// segments with sharp turns (where the speed almost vanishes).
+  ///
+  /// The integration is done w.r.t. the normalized parameter of the
+  /// segment (the arc length doesn't depend on the parameterization),
+  /// otherwise the rounding errors of large grid values would dominate
+  /// the error estimates.  The tolerance is relative to the length of the
+  /// Bezier control polygon, which is an upper bound of the segment
+  /// length.  Since the error estimate is very pessimistic (the actual
+  /// error is typically orders of magnitude smaller), almost all
+  /// sub-intervals need only a single 15-point rule.
+  void _compute_sub_lengths(size_t index)
+  {
+    const auto& a = _segments[index];
+    auto speed = [&a](S x) {
+      return length((S(3) * a[3] * x + S(2) * a[2]) * x + a[1]);
+    };
+    S polygon = (length(a[1]) + length(a[1] + a[2])
+        + length(a[1] + S(2) * a[2] + S(3) * a[3])) / S(3);
+    S tolerance = S(_length_tolerance) * polygon / S(_sub_intervals);
+    S t0 = _grid[index];
+    S t1 = _grid[index + 1];
+    S previous = 0;
+    S segment_length = 0;
+    for (size_t k = 1; k <= _sub_intervals; ++k)
+    {
+      // NB: This must be the same as knot_time() in segment_length_to()
+      //     (mapped like in _segment_velocity())
+      S knot = (k < _sub_intervals)
+        ? (t0 + (t1 - t0) * S(k) / S(_sub_intervals) - t0)
+          * _inverse_durations[index]
+        : S(1);
+      segment_length += adaptive_gauss_kronrod(speed, previous, knot
+          , tolerance, _max_length_intervals, _resource()).value;
+      _sub_lengths[index * _sub_intervals + k - 1] = segment_length;
+      previous = knot;
+    }
+  }
+
+  /// Update cumulative lengths starting at segment "first"
+  void _accumulate_lengths(size_t first)
+  {
+    _cumulative_lengths[0] = 0;
+    for (size_t index = first; index < _segments.size(); ++index)
+    {
+      _cumulative_lengths[index + 1] = _cumulative_lengths[index]
+        + _sub_lengths[(index + 1) * _sub_intervals - 1];
+    }
+  }
+
+  V _segment_evaluate(size_t index, S t) const noexcept
+  {
+    const auto& a = _segments[index];
+    t = (t - _grid[index]) * _inverse_durations[index];
+    return ((a[3] * t + a[2]) * t + a[1]) * t + a[0];
+  }
+
+  V _segment_velocity(size_t index, S t) const noexcept
+  {
+    const auto& b = _velocity_segments[index];
+    t = (t - _grid[index]) * _inverse_durations[index];
+    return (b[2] * t + b[1]) * t + b[0];
+  }
+
+  std::array<V, 3> _segment_derivatives(size_t index, S t) const noexcept
+  {
+    const auto& a = _segments[index];
+    const auto& b = _velocity_segments[index];
+    S inverse_duration = _inverse_durations[index];
+    t = (t - _grid[index]) * inverse_duration;
+    return {
+      ((a[3] * t + a[2]) * t + a[1]) * t + a[0],
+      (b[2] * t + b[1]) * t + b[0],
+      (S(2) * b[2] * t + b[1]) * inverse_duration};
+  }
+
+  /// Number of sub-intervals per segment for pre-computed lengths
+  static constexpr size_t _sub_intervals = 4;
+  /// Relative tolerance for pre-computed lengths, see _compute_sub_lengths()
+  static constexpr double _length_tolerance = 1e-5;
+  /// Maximum number of adaptive intervals per sub-interval
+  static constexpr size_t _max_length_intervals = 16;
+  /// Quadrature order for the remainder within a sub-interval
+  static constexpr size_t _remainder_order = 7;
+  /// Quadrature order for intervals of at most 1 / _short_fraction
+  /// sub-intervals, see segment_length_between()
+  static constexpr size_t _short_order = 3;
+  static constexpr size_t _short_fraction = 16;
+
+  std::pmr::vector<std::array<V, 3>> _velocity_segments;
+  std::pmr::vector<S> _inverse_durations;
+  /// Lengths from the beginning of each segment to its sub-interval ends
+  std::pmr::vector<S> _sub_lengths;
+  std::pmr::vector<S> _cumulative_lengths;
+  GridIndex<S> _grid_index;
 };
 
 }  // namespace asdf
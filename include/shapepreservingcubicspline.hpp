@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cassert>
+#include <memory_resource>
 #include <optional>
 #include <tuple>
 
@@ -14,29 +16,76 @@ private:
   using _base = CubicHermiteSpline<S, S>;
 
 public:
+  /// All vectors (including temporary ones) are allocated from "resource".
   template<typename C1, typename C2>
-  ShapePreservingCubicSpline(const C1& values, const C2& grid, bool closed)
-  : _base(std::make_from_tuple<_base>(_init(values, grid, closed)))
+  ShapePreservingCubicSpline(const C1& values, const C2& grid, bool closed
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(std::make_from_tuple<_base>(_init(values, grid, closed, resource)))
   {}
 
   template<typename C1, typename C2, typename C3>
   ShapePreservingCubicSpline(const C1& values, const C2& slopes, const C3& grid
-      , bool closed)
-  : _base(std::make_from_tuple<_base>(_init(values, slopes, grid, closed)))
+      , bool closed
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(std::make_from_tuple<_base>(
+        _init(values, slopes, grid, closed, resource)))
   {}
 
+  /// Restore a spline that has been stored with save().
+  explicit ShapePreservingCubicSpline(BinaryReader<S>& reader
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _base(reader, resource)
+  {}
+
+protected:
+  /// Replace the knots from index "first" to the end with the given
+  /// values, (optional) slopes and grid values (their number may be
+  /// different, but there must be at least two).
+  ///
+  /// Only the segments from "first + 1" on (or all, if "first" is zero)
+  /// are re-computed, their slopes are the same as if the whole spline
+  /// had been created from scratch.  Therefore, the knots before
+  /// "first + 3" must not have been changed.
+  /// If this throws, the spline is not modified.
+  template<typename C1, typename C2, typename C3>
+  void _replace_tail(size_t first, const C1& values, const C2& slopes
+      , const C3& grid)
+  {
+    assert(first < this->_grid.size());
+    auto local = _init(values, slopes, grid, false, this->_resource());
+    const auto& local_values = std::get<0>(local);
+    const auto& local_slopes = std::get<1>(local);
+    const auto& local_grid = std::get<2>(local);
+    // The slope of the first knot is an end slope
+    size_t skip = first > 0;
+    this->_resize_segments(first + local_grid.size() - 1);
+    this->_grid[first + skip] = local_grid[skip];
+    for (size_t i = skip; i + 1 < local_grid.size(); ++i)
+    {
+      this->_segments[first + i] = _base::_segment(
+          local_values[i], local_values[i + 1]
+          , local_slopes[2 * i], local_slopes[2 * i + 1]
+          , local_grid[i + 1] - local_grid[i]);
+      this->_grid[first + i + 1] = local_grid[i + 1];
+    }
+    this->_update_tail(first + skip);
+  }
+
 private:
   /// Add undefined slopes and call the other _init() overload.
   template<typename C1, typename C2>
-  static auto _init(const C1& values, const C2& grid, bool closed)
+  static auto _init(const C1& values, const C2& grid, bool closed
+      , std::pmr::memory_resource* resource)
   {
-    return _init(
-        values, std::vector<std::optional<S>>(values.size()), grid, closed);
+    return _init(values
+        , std::pmr::vector<std::optional<S>>(values.size(), resource)
+        , grid, closed, resource);
   }
 
+  /// Returns the arguments for the CubicHermiteSpline constructor.
   template<typename C1, typename C2, typename C3>
-  static auto _init(
-      const C1& values_in, const C2& slopes_in, const C3& grid_in, bool closed)
+  static auto _init(const C1& values_in, const C2& slopes_in
+      , const C3& grid_in, bool closed, std::pmr::memory_resource* resource)
   {
     if (values_in.size() < 2)
     {
@@ -52,14 +101,21 @@ private:
       throw std::runtime_error("Number of slopes must be same as values");
     }
 
-    std::tuple<std::vector<S>, std::vector<S>, std::vector<S>> result;
-    auto& [values, slopes, grid] = result;
-
-    // TODO: reserve space for values?
-    // TODO: reserve space for grid?
+    std::tuple<std::pmr::vector<S>, std::pmr::vector<S>, std::pmr::vector<S>
+      , WorkerPool*, std::pmr::memory_resource*>
+      result{resource, resource, resource, nullptr, resource};
+    auto& values = std::get<0>(result);
+    auto& slopes = std::get<1>(result);
+    auto& grid = std::get<2>(result);
 
+    // Closed curves need two more values and one more grid value
+    auto size = values_in.size() + 2 * closed;
+    values.reserve(size);
     values.assign(std::begin(values_in), std::end(values_in));
+    grid.reserve(grid_in.size() + closed);
     grid.assign(std::begin(grid_in), std::end(grid_in));
+    // Two per inner value, one per end value (see below)
+    slopes.reserve(2 * size - 2);
 
     // TODO: check if grid values are increasing?
 
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <algorithm>  // for copy(), max(), min()
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <stdexcept>  // for runtime_error
+#include <type_traits>  // for is_same_v
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ASDFSPLINE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "gridsearch.hpp"
+#include "piecewisecubiccurve.hpp"
+
+namespace asdf {
+
+using std::size_t;
+
+/// Instruction sets that can be used by SoaCubicCurve
+enum class SimdLevel
+{
+  scalar,
+  sse,
+  avx2,
+};
+
+/// The best SimdLevel that is supported by the CPU (detected at runtime).
+/// Without GCC/Clang on x86, this is always SimdLevel::scalar.
+inline SimdLevel supported_simd_level() noexcept
+{
+#ifdef ASDFSPLINE_X86_SIMD
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return SimdLevel::avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+      return SimdLevel::sse;
+    }
+    return SimdLevel::scalar;
+  }();
+  return level;
+#else
+  return SimdLevel::scalar;
+#endif
+}
+
+/// Structure-of-arrays copy of a PiecewiseCubicCurve with D-dimensional
+/// vectors, for evaluating many parameter values at once.
+///
+/// The four coefficients of each vector component of a segment are stored
+/// in a separate aligned block (the D blocks of a segment are adjacent,
+/// which keeps random access as cache-friendly as in PiecewiseCubicCurve).
+/// The coefficients of the velocity (including the inverse segment
+/// duration) are pre-computed as well.
+///
+/// Values are processed in batches of 8.  If all of them are within the
+/// same segment (which is typical for sorted values that are dense
+/// compared to the segments, e.g. at audio sample rate), the coefficients
+/// are broadcast to all lanes.  Otherwise, segments are looked up one by
+/// one (like in PiecewiseCubicCurve::evaluate_many()) and the coefficients
+/// are gathered (AVX2) or transposed (SSE).  The instruction set (AVX2,
+/// SSE or scalar code) is chosen at runtime, see supported_simd_level().
+/// SIMD is only used for S = float.
+///
+/// The results are the same as with PiecewiseCubicCurve::evaluate() and
+/// evaluate_velocity() (up to rounding, which depends on the compiler).
+/// Changes of the original curve are not reflected, a new SoaCubicCurve
+/// has to be created.
+template<typename S, size_t D>
+class SoaCubicCurve
+{
+public:
+  /// "component(v, d)" has to return the component d (0 <= d < D) of
+  /// a vector v, e.g. for Vec3:
+  ///
+  ///     asdf::SoaCubicCurve<float, 3> soa(curve
+  ///         , [](const Vec3<float>& v, size_t d) { return (&v.x)[d]; });
+  ///
+  /// All vectors are allocated from "resource".
+  template<typename V, typename F>
+  SoaCubicCurve(const PiecewiseCubicCurve<S, V>& curve, F component
+      , std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+  : _grid(curve.grid().begin(), curve.grid().end(), resource)
+  , _inverse_durations(resource)
+  , _positions(resource)
+  , _velocities(resource)
+  , _grid_index(resource)
+  {
+    const auto& segments = curve.segments();
+    // Offsets for _mm256_i32gather_ps() are signed
+    if (segments.size() > INT32_MAX / (4 * D))
+    {
+      throw std::runtime_error("Too many segments for SoaCubicCurve");
+    }
+    _inverse_durations.resize(segments.size());
+    _positions.resize(segments.size() * D);
+    _velocities.resize(segments.size() * D);
+    for (size_t index = 0; index < segments.size(); ++index)
+    {
+      // NB: This must be the same as PiecewiseCubicCurve::_precompute()
+      S inverse_duration = S(1) / (_grid[index + 1] - _grid[index]);
+      _inverse_durations[index] = inverse_duration;
+      const auto& a = segments[index];
+      for (size_t d = 0; d < D; ++d)
+      {
+        _positions[index * D + d].c = {
+          component(a[0], d),
+          component(a[1], d),
+          component(a[2], d),
+          component(a[3], d)};
+        // A cubic with zero leading coefficient, which gives the same
+        // result as the quadratic in PiecewiseCubicCurve
+        _velocities[index * D + d].c = {
+                 inverse_duration * component(a[1], d),
+          S(2) * inverse_duration * component(a[2], d),
+          S(3) * inverse_duration * component(a[3], d),
+          S(0)};
+      }
+    }
+    _grid_index.build(_grid);
+  }
+
+  /// Evaluate at the "count" parameter values starting at "t".  Component
+  /// d of the i-th result is written to out[d][i].
+  /// This is fastest if the values are sorted.
+  ///
+  /// "level" can be used to limit the instruction set (e.g. for testing),
+  /// it is reduced to the supported one if necessary.
+  /// This doesn't allocate memory and doesn't throw.
+  void evaluate_many(const S* t, size_t count, const std::array<S*, D>& out
+      , SimdLevel level = supported_simd_level()) const noexcept
+  {
+    _evaluate_many(_positions.data(), t, count, out, level);
+  }
+
+  /// Like evaluate_many(), but for velocities.
+  void evaluate_velocity_many(const S* t, size_t count
+      , const std::array<S*, D>& out
+      , SimdLevel level = supported_simd_level()) const noexcept
+  {
+    _evaluate_many(_velocities.data(), t, count, out, level);
+  }
+
+  auto& grid() const { return _grid; }
+
+private:
+  /// Polynomial coefficients (starting with the constant term) of one
+  /// component of one segment
+  struct alignas(4 * sizeof(S)) _Block
+  {
+    std::array<S, 4> c;
+  };
+
+  static constexpr size_t _batch = 8;
+
+  void _evaluate_many(const _Block* blocks, const S* t, size_t count
+      , const std::array<S*, D>& out, SimdLevel level) const noexcept
+  {
+    level = std::min(level, supported_simd_level());
+    std::array<std::uint32_t, _batch> indices;
+    std::array<S, _batch> x;
+    std::array<std::array<S, _batch>, D> temp;
+    std::array<S*, D> result;
+    size_t index = 0;
+    for (size_t i = 0; i < count; i += _batch)
+    {
+      size_t n = std::min(count - i, _batch);
+      bool same = n == _batch && _same_segment(t + i, index);
+      if (same)
+      {
+        indices[0] = static_cast<std::uint32_t>(index);
+        S start = _grid[index];
+        S inverse_duration = _inverse_durations[index];
+        for (size_t j = 0; j < _batch; ++j)
+        {
+          // NB: This must be the same as in PiecewiseCubicCurve
+          x[j] = (t[i + j] - start) * inverse_duration;
+        }
+      }
+      else
+      {
+        for (size_t j = 0; j < n; ++j)
+        {
+          S u = t[i + j];
+          index = _get_segment_and_trim(u, index);
+          indices[j] = static_cast<std::uint32_t>(index);
+          x[j] = (u - _grid[index]) * _inverse_durations[index];
+        }
+        // Unused lanes of the last batch
+        for (size_t j = n; j < _batch; ++j)
+        {
+          indices[j] = indices[0];
+          x[j] = 0;
+        }
+      }
+      for (size_t d = 0; d < D; ++d)
+      {
+        result[d] = (n == _batch) ? out[d] + i : temp[d].data();
+      }
+      _evaluate_batch(blocks, indices.data(), same, x.data(), result, level);
+      if (n < _batch)
+      {
+        for (size_t d = 0; d < D; ++d)
+        {
+          std::copy(temp[d].begin(), temp[d].begin() + n, out[d] + i);
+        }
+      }
+    }
+  }
+
+  /// Whether all values of a batch are within the segment "index" or the
+  /// next one (other segments are not searched, this should be cheap if it
+  /// fails).  If true, "index" is set to that segment.
+  bool _same_segment(const S* t, size_t& index) const noexcept
+  {
+    S min = t[0];
+    S max = t[0];
+    for (size_t j = 1; j < _batch; ++j)
+    {
+      min = std::min(min, t[j]);
+      max = std::max(max, t[j]);
+    }
+    size_t candidate = index;
+    if (candidate + 2 < _grid.size() && _grid[candidate + 1] <= min)
+    {
+      ++candidate;
+    }
+    // NB: This is also false for NaN
+    if (_grid[candidate] <= min && max < _grid[candidate + 1])
+    {
+      index = candidate;
+      return true;
+    }
+    return false;
+  }
+
+  /// Same as PiecewiseCubicCurve::_get_segment_and_trim(S&, size_t)
+  size_t _get_segment_and_trim(S& t, size_t index) const noexcept
+  {
+    if (t < _grid.front())
+    {
+      t = _grid.front();
+      return 0;
+    }
+    if (t < _grid.back())
+    {
+      return _grid_index.find(_grid, t, index);
+    }
+    t = _grid.back();
+    return _grid.size() - 2;
+  }
+
+  /// Evaluate the polynomials of all components at the values "x"
+  /// (relative to their segment) and write them to "out".  If "same",
+  /// all values are within the segment indices[0], otherwise each value
+  /// has its own segment.
+  static void _evaluate_batch(const _Block* blocks
+      , const std::uint32_t* indices, bool same, const S* x
+      , const std::array<S*, D>& out, SimdLevel level) noexcept
+  {
+#ifdef ASDFSPLINE_X86_SIMD
+    if constexpr (std::is_same_v<S, float>)
+    {
+      if (level == SimdLevel::avx2)
+      {
+        _evaluate_batch_avx2(blocks, indices, same, x, out);
+        return;
+      }
+      if (level == SimdLevel::sse)
+      {
+        _evaluate_batch_sse(blocks, indices, same, x, out);
+        return;
+      }
+    }
+#endif
+    (void)level;
+    for (size_t d = 0; d < D; ++d)
+    {
+      for (size_t j = 0; j < _batch; ++j)
+      {
+        const auto& a = blocks[indices[same ? 0 : j] * D + d].c;
+        out[d][j] = ((a[3] * x[j] + a[2]) * x[j] + a[1]) * x[j] + a[0];
+      }
+    }
+  }
+
+#ifdef ASDFSPLINE_X86_SIMD
+  /// Two times four values.  If the segments differ, four blocks are
+  /// loaded (aligned) and transposed, which gives the coefficients of
+  /// each order for four segments.
+  __attribute__((target("sse2")))
+  static void _evaluate_batch_sse(const _Block* blocks
+      , const std::uint32_t* indices, bool same, const float* x
+      , const std::array<float*, D>& out) noexcept
+  {
+    for (size_t half = 0; half < _batch; half += 4)
+    {
+      __m128 xs = _mm_loadu_ps(x + half);
+      for (size_t d = 0; d < D; ++d)
+      {
+        __m128 a0, a1, a2, a3;
+        if (same)
+        {
+          const auto& a = blocks[indices[0] * D + d].c;
+          a0 = _mm_set1_ps(a[0]);
+          a1 = _mm_set1_ps(a[1]);
+          a2 = _mm_set1_ps(a[2]);
+          a3 = _mm_set1_ps(a[3]);
+        }
+        else
+        {
+          const std::uint32_t* i = indices + half;
+          a0 = _mm_load_ps(blocks[i[0] * D + d].c.data());
+          a1 = _mm_load_ps(blocks[i[1] * D + d].c.data());
+          a2 = _mm_load_ps(blocks[i[2] * D + d].c.data());
+          a3 = _mm_load_ps(blocks[i[3] * D + d].c.data());
+          _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+        }
+        __m128 result = _mm_add_ps(_mm_mul_ps(a3, xs), a2);
+        result = _mm_add_ps(_mm_mul_ps(result, xs), a1);
+        result = _mm_add_ps(_mm_mul_ps(result, xs), a0);
+        _mm_storeu_ps(out[d] + half, result);
+      }
+    }
+  }
+
+  /// Eight values at once.  If the segments differ, the coefficients of
+  /// each order are gathered.
+  __attribute__((target("avx2")))
+  static void _evaluate_batch_avx2(const _Block* blocks
+      , const std::uint32_t* indices, bool same, const float* x
+      , const std::array<float*, D>& out) noexcept
+  {
+    __m256 xs = _mm256_loadu_ps(x);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(indices))
+        , _mm256_set1_epi32(4 * D));
+    for (size_t d = 0; d < D; ++d)
+    {
+      __m256 a0, a1, a2, a3;
+      if (same)
+      {
+        const auto& a = blocks[indices[0] * D + d].c;
+        a0 = _mm256_set1_ps(a[0]);
+        a1 = _mm256_set1_ps(a[1]);
+        a2 = _mm256_set1_ps(a[2]);
+        a3 = _mm256_set1_ps(a[3]);
+      }
+      else
+      {
+        const float* base = blocks[d].c.data();
+        a0 = _mm256_i32gather_ps(base, offsets, 4);
+        a1 = _mm256_i32gather_ps(base + 1, offsets, 4);
+        a2 = _mm256_i32gather_ps(base + 2, offsets, 4);
+        a3 = _mm256_i32gather_ps(base + 3, offsets, 4);
+      }
+      __m256 result = _mm256_add_ps(_mm256_mul_ps(a3, xs), a2);
+      result = _mm256_add_ps(_mm256_mul_ps(result, xs), a1);
+      result = _mm256_add_ps(_mm256_mul_ps(result, xs), a0);
+      _mm256_storeu_ps(out[d], result);
+    }
+  }
+#endif
+
+  std::pmr::vector<S> _grid;
+  std::pmr::vector<S> _inverse_durations;
+  /// D blocks per segment
+  std::pmr::vector<_Block> _positions;
+  std::pmr::vector<_Block> _velocities;
+  GridIndex<S> _grid_index;
+};
+
+}  // namespace asdf
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "asdfspline.hpp"
+#include "instrumentation.hpp"
+
+namespace asdf {
+
+/// Evaluation of an AsdfSpline at a (typically slowly advancing) time.
+///
+/// Segment indices and the previous arc length solution are kept from one
+/// call to the next.  Therefore, small steps (e.g. one per audio block)
+/// don't need any binary searches and typically only one quadrature.
+/// Seeking to arbitrary times (including backwards) is possible as well.
+///
+/// Like AsdfSpline::evaluate(), all evaluation functions are real-time
+/// safe (no allocations, no locks, no exceptions).
+///
+/// NB: The spline must outlive the cursor (or the cursor must be moved
+///     to another spline with rebind()).  If the spline is modified,
+///     the cursor state is reset on the next evaluation.
+template<typename S, typename V>
+class SplineCursor
+{
+public:
+  explicit SplineCursor(const AsdfSpline<S, V>& spline, S time = 0)
+  : _spline(&spline)
+  , _time(time)
+  , _revision(spline._revision)
+  {}
+
+  /// Move to time t and return position.
+  V seek(S t) noexcept
+  {
+    _time = t;
+    return this->evaluate();
+  }
+
+  /// Move forward by dt (or backwards, if negative) and return position.
+  V advance(S dt) noexcept
+  {
+    return this->seek(_time + dt);
+  }
+
+  /// Current time
+  S time() const { return _time; }
+
+  /// Continue on another spline (at the current time), e.g. after
+  /// acquiring the latest one from a SplineHandle.  If it's not the same
+  /// (unmodified) spline, the state is reset.
+  void rebind(const AsdfSpline<S, V>& spline) noexcept
+  {
+    if (&spline != _spline)
+    {
+      _spline = &spline;
+      _hint = {};
+      _revision = spline._revision;
+    }
+  }
+
+  /// Position at current time
+  V evaluate() noexcept
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::cursor_evaluate);
+    _check_revision();
+    return _spline->_evaluate(_time, _hint);
+  }
+
+  /// Velocity at current time.
+  /// If the position at the same time has been requested before,
+  /// this re-uses its arc length solution.
+  V evaluate_velocity() noexcept
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::cursor_evaluate_velocity);
+    _check_revision();
+    return _spline->_evaluate_velocity(_time, _hint);
+  }
+
+  /// Position, velocity and acceleration at current time,
+  /// see AsdfSpline::evaluate_state().
+  typename AsdfSpline<S, V>::State evaluate_state() noexcept
+  {
+    instrumentation::ScopedLatency latency(
+        instrumentation::Api::cursor_evaluate_state);
+    _check_revision();
+    return _spline->_evaluate_state(_time, _hint);
+  }
+
+private:
+  void _check_revision() noexcept
+  {
+    if (_revision != _spline->_revision)
+    {
+      _hint = {};
+      _revision = _spline->_revision;
+    }
+  }
+
+  const AsdfSpline<S, V>* _spline;
+  typename AsdfSpline<S, V>::_Hint _hint;
+  S _time;
+  size_t _revision;
+};
+
+}  // namespace asdf
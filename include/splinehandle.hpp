@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>  // for min()
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>  // for numeric_limits
+#include <memory>  // for unique_ptr, make_unique()
+#include <mutex>
+#include <stdexcept>  // for runtime_error
+#include <utility>  // for move(), exchange(), forward()
+#include <vector>
+
+namespace asdf {
+
+using std::size_t;
+
+/// Shared ownership of a (typically AsdfSpline) object that can be
+/// replaced by a control thread while real-time threads are reading it.
+///
+/// This is a simple form of read-copy-update (RCU): a new object is
+/// created on the control thread and published with an atomic pointer
+/// swap.  Readers keep using the previous object until they release it,
+/// they never block, allocate or free memory.  Replaced objects are
+/// destroyed by publish() or collect() (on the control thread) once no
+/// reader can use them anymore.
+///
+/// Each reading thread needs its own Reader, which must be obtained on
+/// the control thread, since there is only a fixed number of them:
+///
+///     // Control thread
+///     asdf::SplineHandle<Spline> handle(std::make_unique<Spline>(data));
+///     auto reader = handle.reader();
+///     ...
+///     handle.emplace(new_data);
+///
+///     // Real-time thread
+///     auto spline = reader.lock();
+///     cursor.rebind(*spline);
+///     cursor.seek(t);
+///
+/// Reclamation uses epochs: each publication increments a global epoch,
+/// each lock() announces the epoch it has seen.  An object retired at
+/// epoch E can be destroyed when all active readers have announced a
+/// later epoch.  Lock and release are wait-free, they only need three
+/// atomic operations.
+template<typename T>
+class SplineHandle
+{
+private:
+  /// Announced epoch of a reader (0 means it doesn't hold an object)
+  struct alignas(64) _Slot
+  {
+    std::atomic<std::uint64_t> epoch{0};
+    std::atomic<bool> taken{false};
+  };
+
+public:
+  /// Access to the current object, see Reader::lock().
+  /// The object stays valid until the Guard is destroyed.
+  class Guard
+  {
+  public:
+    Guard(Guard&& other) noexcept
+    : _slot(std::exchange(other._slot, nullptr))
+    , _object(other._object)
+    {}
+
+    Guard& operator=(Guard&& other) noexcept
+    {
+      if (this != &other)
+      {
+        release();
+        _slot = std::exchange(other._slot, nullptr);
+        _object = other._object;
+      }
+      return *this;
+    }
+
+    ~Guard() { release(); }
+
+    /// Release the object early (afterwards, get() must not be used).
+    void release() noexcept
+    {
+      if (_slot)
+      {
+        _slot->epoch.store(0, std::memory_order_release);
+        _slot = nullptr;
+      }
+    }
+
+    /// Null if nothing has been published
+    const T* get() const noexcept { return _object; }
+    const T& operator*() const noexcept { return *_object; }
+    const T* operator->() const noexcept { return _object; }
+    explicit operator bool() const noexcept { return _object != nullptr; }
+
+  private:
+    friend class SplineHandle;
+
+    Guard(_Slot* slot, const T* object) noexcept
+    : _slot(slot)
+    , _object(object)
+    {}
+
+    _Slot* _slot;
+    const T* _object;
+  };
+
+  /// Read access for a single thread, see SplineHandle::reader().
+  class Reader
+  {
+  public:
+    Reader(Reader&& other) noexcept
+    : _handle(std::exchange(other._handle, nullptr))
+    , _slot(std::exchange(other._slot, nullptr))
+    {}
+
+    Reader& operator=(Reader&& other) noexcept
+    {
+      if (this != &other)
+      {
+        _free();
+        _handle = std::exchange(other._handle, nullptr);
+        _slot = std::exchange(other._slot, nullptr);
+      }
+      return *this;
+    }
+
+    ~Reader() { _free(); }
+
+    /// Acquire the most recently published object.
+    ///
+    /// This is wait-free and real-time safe.  Only one Guard per Reader
+    /// may exist at a time.
+    Guard lock() noexcept
+    {
+      assert(_slot);
+      assert(_slot->epoch.load(std::memory_order_relaxed) == 0);
+      // NB: Sequentially consistent, see _collect()
+      _slot->epoch.store(_handle->_epoch.load());
+      return Guard(_slot, _handle->_current.load());
+    }
+
+  private:
+    friend class SplineHandle;
+
+    Reader(SplineHandle* handle, _Slot* slot) noexcept
+    : _handle(handle)
+    , _slot(slot)
+    {}
+
+    void _free() noexcept
+    {
+      if (_slot)
+      {
+        assert(_slot->epoch.load() == 0);
+        _slot->taken.store(false, std::memory_order_release);
+        _slot = nullptr;
+      }
+    }
+
+    SplineHandle* _handle;
+    _Slot* _slot;
+  };
+
+  /// "max_readers" is the number of Reader objects that can exist at the
+  /// same time (typically one per real-time thread).
+  explicit SplineHandle(std::unique_ptr<T> object = nullptr
+      , size_t max_readers = 1)
+  : _slots(std::make_unique<_Slot[]>(max_readers))
+  , _max_readers(max_readers)
+  , _current(object.release())
+  {}
+
+  SplineHandle(const SplineHandle&) = delete;
+  SplineHandle& operator=(const SplineHandle&) = delete;
+
+  /// NB: All Reader objects must have been destroyed before.
+  ~SplineHandle()
+  {
+    for (size_t i = 0; i < _max_readers; ++i)
+    {
+      assert(!_slots[i].taken.load());
+    }
+    delete _current.load();
+  }
+
+  /// Get a Reader for one real-time thread.
+  /// This is not real-time safe, it should be called on the control thread.
+  ///
+  /// std::runtime_error is thrown if there are already "max_readers".
+  Reader reader()
+  {
+    for (size_t i = 0; i < _max_readers; ++i)
+    {
+      if (!_slots[i].taken.exchange(true, std::memory_order_acquire))
+      {
+        return Reader(this, &_slots[i]);
+      }
+    }
+    throw std::runtime_error("Maximum number of readers reached");
+  }
+
+  /// Replace the current object.  The previous object is destroyed
+  /// (now or during a later publish() or collect()) once it isn't used
+  /// by any reader.
+  /// This may be called concurrently from multiple control threads,
+  /// but it is not real-time safe.
+  void publish(std::unique_ptr<T> object)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Allocate first, so that nothing is lost if this throws
+    _retired.reserve(_retired.size() + 1);
+    T* previous = _current.exchange(object.release());
+    auto epoch = _epoch.fetch_add(1);
+    if (previous)
+    {
+      _retired.push_back({epoch, std::unique_ptr<T>(previous)});
+    }
+    _collect();
+  }
+
+  /// Construct a new object from "args" and publish() it.
+  template<typename... Args>
+  void emplace(Args&&... args)
+  {
+    this->publish(std::make_unique<T>(std::forward<Args>(args)...));
+  }
+
+  /// Destroy all replaced objects that aren't used anymore.
+  /// This is done on each publish(), but if the readers were still using
+  /// the previous object at that time, it is kept until the next call.
+  /// Returns the number of objects that are still waiting.
+  size_t collect()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _collect();
+    return _retired.size();
+  }
+
+private:
+  struct _Retired
+  {
+    /// Epoch before the object was replaced
+    std::uint64_t epoch;
+    std::unique_ptr<T> object;
+  };
+
+  /// A reader that has obtained a replaced object has loaded the epoch
+  /// before the object was replaced (because all involved operations are
+  /// sequentially consistent), therefore it has announced an epoch that
+  /// is not later than the one stored in _Retired.
+  void _collect()
+  {
+    auto oldest = std::numeric_limits<std::uint64_t>::max();
+    for (size_t i = 0; i < _max_readers; ++i)
+    {
+      if (auto epoch = _slots[i].epoch.load())
+      {
+        oldest = std::min(oldest, epoch);
+      }
+    }
+    auto end = std::remove_if(_retired.begin(), _retired.end()
+        , [oldest](const _Retired& retired) {
+      return retired.epoch < oldest;
+    });
+    _retired.erase(end, _retired.end());
+  }
+
+  std::unique_ptr<_Slot[]> _slots;
+  size_t _max_readers;
+  std::atomic<T*> _current;
+  /// Starts at 1, because 0 marks inactive readers
+  std::atomic<std::uint64_t> _epoch{1};
+  std::mutex _mutex;
+  std::vector<_Retired> _retired;
+};
+
+}  // namespace asdf
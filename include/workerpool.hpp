@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>  // for min()
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>  // for exception_ptr
+#include <mutex>
+#include <thread>
+#include <utility>  // for exchange()
+#include <vector>
+
+namespace asdf {
+
+using std::size_t;
+
+/// Fixed set of threads for data-parallel loops.
+///
+/// The threads are started once and then wait for work, which avoids
+/// the overhead of starting new threads for each (short) loop.
+class WorkerPool
+{
+public:
+  /// "threads" is the total number of threads, including the calling one.
+  /// If a thread cannot be started, the ones already started are
+  /// stopped and the exception is re-thrown.
+  explicit WorkerPool(size_t threads = 1)
+  {
+    try
+    {
+      for (size_t i = 1; i < threads; ++i)
+      {
+        _workers.emplace_back([this]() { _run(); });
+      }
+    }
+    catch (...)
+    {
+      _stop_workers();
+      throw;
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  ~WorkerPool() { _stop_workers(); }
+
+  /// Total number of threads, including the calling one.
+  size_t threads() const { return _workers.size() + 1; }
+
+  /// Call f(begin, end) for consecutive chunks of the range [0, size).
+  ///
+  /// Chunks are handed out dynamically to all threads (including the
+  /// calling one), so that faster threads process more chunks.
+  /// Returns when all chunks have been processed.  Once no chunks are
+  /// left, the calling thread spins (yielding its time slice) while other
+  /// threads finish their last chunk, and only blocks on a mutex if that
+  /// takes longer than _spin_count iterations.
+  /// If f throws, no further chunks are started and the (first) exception
+  /// is re-thrown in the calling thread.
+  ///
+  /// NB: Calls must not overlap.
+  template<typename F>
+  void parallel_for(size_t size, size_t chunk_size, F f)
+  {
+    assert(chunk_size > 0);
+    if (size == 0)
+    {
+      return;
+    }
+    if (_workers.empty() || size <= chunk_size)
+    {
+      f(size_t(0), size);
+      return;
+    }
+    Job job{&_invoke<F>, &f, size, chunk_size};
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _job = job;
+      _next = 0;
+      _busy = _workers.size();
+      ++_generation;
+    }
+    _start.notify_all();
+    _process(job);
+    for (size_t i = 0; i < _spin_count && _busy.load() != 0; ++i)
+    {
+      std::this_thread::yield();
+    }
+    if (_busy.load() != 0)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done.wait(lock, [this]() { return _busy.load() == 0; });
+    }
+    if (_exception)
+    {
+      std::rethrow_exception(std::exchange(_exception, nullptr));
+    }
+  }
+
+private:
+  /// Type-erased loop body (without allocation)
+  struct Job
+  {
+    void (*invoke)(void*, size_t, size_t);
+    void* function;
+    size_t size;
+    size_t chunk_size;
+  };
+
+  template<typename F>
+  static void _invoke(void* function, size_t begin, size_t end)
+  {
+    (*static_cast<F*>(function))(begin, end);
+  }
+
+  void _process(const Job& job)
+  {
+    for (;;)
+    {
+      size_t begin = _next.fetch_add(job.chunk_size);
+      if (begin >= job.size)
+      {
+        break;
+      }
+      try
+      {
+        job.invoke(job.function, begin
+            , std::min(begin + job.chunk_size, job.size));
+      }
+      catch (...)
+      {
+        _next = job.size;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_exception)
+        {
+          _exception = std::current_exception();
+        }
+      }
+    }
+  }
+
+  void _stop_workers() noexcept
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _start.notify_all();
+    for (auto& worker: _workers)
+    {
+      worker.join();
+    }
+  }
+
+  void _run()
+  {
+    size_t generation = 0;
+    for (;;)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _start.wait(lock, [this, generation]() {
+          return _stop || _generation != generation;
+        });
+        if (_stop)
+        {
+          return;
+        }
+        generation = _generation;
+        job = _job;
+      }
+      _process(job);
+      if (--_busy == 0)
+      {
+        // Locking ensures that the calling thread is either already
+        // waiting or hasn't yet checked _busy
+        { std::lock_guard<std::mutex> lock(_mutex); }
+        _done.notify_one();
+      }
+    }
+  }
+
+  /// Number of yields in parallel_for() before blocking
+  static constexpr size_t _spin_count = 1000;
+
+  std::vector<std::thread> _workers;
+  std::mutex _mutex;
+  std::condition_variable _start;
+  std::condition_variable _done;
+  Job _job{};
+  /// Start of the next chunk to be processed
+  std::atomic<size_t> _next{0};
+  /// Number of workers that haven't finished the current job
+  /// This is atomic, so that parallel_for() can spin on it
+  std::atomic<size_t> _busy{0};
+  /// Incremented for each job
+  size_t _generation = 0;
+  bool _stop = false;
+  std::exception_ptr _exception;
+};
+
+/// Use the given pool or (if it is nullptr) call f(0, size) directly.
+template<typename F>
+void parallel_for(WorkerPool* pool, size_t size, size_t chunk_size, F f)
+{
+  if (pool)
+  {
+    pool->parallel_for(size, chunk_size, f);
+  }
+  else if (size)
+  {
+    f(size_t(0), size);
+  }
+}
+
+}  // namespace asdf
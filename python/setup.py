@@ -1,6 +1,7 @@
 from setuptools import setup, Extension
 from setuptools.command.build_ext import build_ext
 import setuptools
+import os
 import sys
 
 # https://github.com/pybind/python_example
@@ -33,17 +34,31 @@ ext_modules = [
             get_pybind_include(user=True),
         ],
         depends=[
+            'asdfscene.hpp',
             'asdfspline.hpp',
-            'bisect.hpp',
+            'asdfsplinebuilder.hpp',
+            'binaryformat.hpp',
+            'boundingspheretree.hpp',
             'centripetalkochanekbartelsspline.hpp',
             'cubichermitespline.hpp',
+            'gauss-kronrod.hpp',
             'gauss-legendre.hpp',
+            'gridsearch.hpp',
+            'instrumentation.hpp',
             'monotonecubicspline.hpp',
+            'newton.hpp',
             'piecewisecubiccurve.hpp',
             'shapepreservingcubicspline.hpp',
+            'soacubiccurve.hpp',
+            'splinecursor.hpp',
+            'splinehandle.hpp',
+            'workerpool.hpp',
         ],
         language='c++',
         undef_macros=['NDEBUG'],  # Debug mode, enable assertions
+        # Counters and latency histograms, see instrumentation.hpp
+        define_macros=[('ASDFSPLINE_INSTRUMENTATION', None)]
+        if os.environ.get('ASDFSPLINE_INSTRUMENTATION') == '1' else [],
     ),
 ]
 
@@ -88,9 +103,14 @@ class BuildExt(build_ext):
             #'-Wshadow',
             '-Wstrict-overflow',
             '-Wwrite-strings',
+            '-pthread',  # For multi-threaded evaluation
         ],
     }
 
+    l_opts = {
+        'unix': ['-pthread'],
+    }
+
     if sys.platform == 'darwin':
         c_opts['unix'] += ['-stdlib=libc++', '-mmacosx-version-min=10.7']
 
@@ -113,6 +133,7 @@ class BuildExt(build_ext):
                         % self.distribution.get_version())
         for ext in self.extensions:
             ext.extra_compile_args = opts
+            ext.extra_link_args = self.l_opts.get(ct, [])
         build_ext.build_extensions(self)
 
 
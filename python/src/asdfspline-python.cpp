@@ -1,8 +1,12 @@
 #include <pybind11/pybind11.h>
 //#include <pybind11/stl.h>
 #include <pybind11/numpy.h>
+#include <algorithm>  // for copy(), max(), min()
+#include <iterator>  // for back_inserter()
 #include "asdfspline.hpp"
+#include "instrumentation.hpp"
 #include "vec3.hpp"
+#include "workerpool.hpp"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -13,10 +17,152 @@ class AsdfSpline : public asdf::AsdfSpline<T, Vec3<T>>
 public:
   using V = Vec3<T>;
 
-  explicit AsdfSpline(py::iterable data)
-  : asdf::AsdfSpline<T, V>(_init(data))
+  AsdfSpline(py::iterable data, size_t s2u_knots, size_t threads)
+  : asdf::AsdfSpline<T, V>(_init(data), s2u_knots, threads)
   {}
 
+  explicit AsdfSpline(asdf::BinaryReader<T>& reader)
+  : asdf::AsdfSpline<T, V>(reader)
+  {}
+
+  /// Binary representation for pickling, see asdf::BinaryFormat
+  py::bytes get_state() const
+  {
+    asdf::BinaryWriter<T> writer;
+    this->save(writer);
+    return py::bytes(writer.data());
+  }
+
+  static AsdfSpline set_state(const py::bytes& state)
+  {
+    char* data;
+    Py_ssize_t size;
+    if (PyBytes_AsStringAndSize(state.ptr(), &data, &size) != 0)
+    {
+      throw py::error_already_set();
+    }
+    asdf::BinaryReader<T> reader(data, static_cast<size_t>(size));
+    AsdfSpline result(reader);
+    if (reader.remaining())
+    {
+      throw std::runtime_error("Unexpected data after ASDF spline");
+    }
+    return result;
+  }
+
+  /// Evaluate positions at an array of times.
+  /// A 0-dimensional array returns a single position,
+  /// a 1-dimensional array of N times returns an array of shape (N, 3).
+  py::object evaluate_array(py::array_t<T, py::array::c_style
+      | py::array::forcecast> t, size_t threads) const
+  {
+    return _evaluate_array(t, threads, [this](auto first, auto last, auto out) {
+      this->evaluate_many(first, last, out);
+    });
+  }
+
+  /// Same as evaluate_array(), but for velocities.
+  py::object evaluate_velocity_array(py::array_t<T, py::array::c_style
+      | py::array::forcecast> t, size_t threads) const
+  {
+    return _evaluate_array(t, threads, [this](auto first, auto last, auto out) {
+      this->evaluate_velocity_many(first, last, out);
+    });
+  }
+
+  /// evaluate_at_distance() for a scalar or an array of arc lengths
+  py::object evaluate_at_distance_array(py::array_t<T, py::array::c_style
+      | py::array::forcecast> s, size_t threads) const
+  {
+    return _evaluate_array(s, threads, [this](auto first, auto last, auto out) {
+      this->evaluate_at_distance(first, last, out);
+    });
+  }
+
+  /// sample_by_distance() as an array of shape (N, 3)
+  py::array_t<T> sample_by_distance_array(T step) const
+  {
+    std::vector<V> positions;
+    {
+      py::gil_scoped_release release;
+      this->sample_by_distance(step, std::back_inserter(positions));
+    }
+    py::array_t<T> result({py::ssize_t(positions.size()), py::ssize_t(3)});
+    static_assert(sizeof(V) == 3 * sizeof(T));
+    std::copy(positions.begin(), positions.end()
+        , reinterpret_cast<V*>(result.mutable_data()));
+    return result;
+  }
+
+  /// evaluate_state() as a dict
+  py::dict evaluate_state_dict(T t) const
+  {
+    auto state = this->evaluate_state(t);
+    return py::dict("position"_a = state.position,
+                    "velocity"_a = state.velocity,
+                    "acceleration"_a = state.acceleration,
+                    "speed"_a = state.speed,
+                    "arc_length"_a = state.arc_length);
+  }
+
+  /// closest_point() as a dict
+  py::dict closest_point_dict(V point) const
+  {
+    auto closest = this->closest_point(point);
+    return py::dict("position"_a = closest.position,
+                    "distance"_a = closest.distance,
+                    "time"_a = closest.time,
+                    "arc_length"_a = closest.arc_length);
+  }
+
+  /// time_intervals_within() as a list of tuples
+  py::list time_intervals_within_list(V point, T radius, py::object t0,
+                                      py::object t1) const
+  {
+    auto begin = t0.is_none() ? this->grid().front() : t0.cast<T>();
+    auto end = t1.is_none() ? this->grid().back() : t1.cast<T>();
+    py::list result;
+    for (auto [first, last]: this->time_intervals_within(point, radius,
+                                                         begin, end))
+    {
+      result.append(py::make_tuple(first, last));
+    }
+    return result;
+  }
+
+  /// update_time() with None instead of std::optional
+  void update_time_or_none(size_t i, py::object time, py::object speed)
+  {
+    std::optional<T> t;
+    std::optional<T> v;
+    if (!time.is_none())
+    {
+      t = time.cast<T>();
+    }
+    if (!speed.is_none())
+    {
+      v = speed.cast<T>();
+    }
+    this->update_time(i, t, v);
+  }
+
+  /// append_vertex() with None instead of std::optional
+  void append_vertex_or_none(V position, T time, py::object speed
+      , T tension, T continuity, T bias)
+  {
+    std::optional<T> v;
+    if (!speed.is_none())
+    {
+      v = speed.cast<T>();
+    }
+    this->append_vertex(position, time, v, {tension, continuity, bias});
+  }
+
+  void update_tcb_values(size_t i, T tension, T continuity, T bias)
+  {
+    this->update_tcb(i, {tension, continuity, bias});
+  }
+
   auto grid_as_array() const
   {
     auto& grid = this->grid();
@@ -29,6 +175,42 @@ public:
   }
 
 private:
+  template<typename F>
+  static py::object _evaluate_array(const py::array_t<T, py::array::c_style
+      | py::array::forcecast>& t, size_t threads, F evaluate_many)
+  {
+    if (t.ndim() == 0)
+    {
+      V result;
+      evaluate_many(t.data(), t.data() + 1, &result);
+      return py::cast(result);
+    }
+    if (t.ndim() != 1)
+    {
+      throw py::value_error("t must be a scalar or a one-dimensional array");
+    }
+    auto size = static_cast<size_t>(t.shape(0));
+    py::array_t<T> result({t.shape(0), py::ssize_t(3)});
+    static_assert(sizeof(V) == 3 * sizeof(T));
+    const T* input = t.data();
+    V* output = reinterpret_cast<V*>(result.mutable_data());
+    {
+      py::gil_scoped_release release;
+      // Each thread gets a contiguous chunk, for sorted input this means
+      // that search hints are re-used within each chunk.
+      threads = std::max(size_t(1), std::min(threads, size / _min_chunk_size));
+      size_t chunk_size = (size + threads - 1) / threads;
+      asdf::WorkerPool pool(threads);
+      pool.parallel_for(size, chunk_size, [&](size_t begin, size_t end) {
+        evaluate_many(input + begin, input + end, output + begin);
+      });
+    }
+    return result;
+  }
+
+  /// Don't start threads for fewer times than that
+  static constexpr size_t _min_chunk_size = 1000;
+
   auto _init(py::iterable data)
   {
     std::vector<typename asdf::AsdfSpline<T, V>::AsdfVertex> vertices;
@@ -126,21 +308,148 @@ namespace pybind11 { namespace detail {
   };
 }}
 
+/// Counters and latency histograms of all threads as nested dicts
+py::dict instrumentation_snapshot()
+{
+  namespace instr = asdf::instrumentation;
+  auto snapshot = instr::snapshot();
+  py::dict counters;
+  for (size_t i = 0; i < instr::counter_count; ++i)
+  {
+    counters[instr::counter_names[i]] = snapshot.counters[i];
+  }
+  py::dict latencies;
+  for (size_t i = 0; i < instr::api_count; ++i)
+  {
+    py::list histogram;
+    for (auto value: snapshot.latencies[i])
+    {
+      histogram.append(value);
+    }
+    latencies[instr::api_names[i]] = histogram;
+  }
+  return py::dict("enabled"_a = instr::enabled, "counters"_a = counters,
+                  "latencies"_a = latencies);
+}
+
 
 PYBIND11_MODULE(asdfspline, m) {
   m.doc() = R"raw(ASDF splines.)raw";
 
   py::class_<AsdfSpline<float>>(m, "AsdfSpline",
 R"raw(ASDF spline.)raw")
-    .def(py::init<py::iterable>(), "data"_a,
-R"raw(Construct a spline from an iterable of dicts.)raw")
-    .def("evaluate", &AsdfSpline<float>::evaluate, "t"_a,
+    .def(py::init<py::iterable, size_t, size_t>(), "data"_a,
+        "s2u_knots"_a = 0, "threads"_a = 1,
+R"raw(Construct a spline from an iterable of dicts.
+
+If *s2u_knots* is non-zero, a table for arc length inversion is created,
+which makes construction slower but evaluation much faster.
+For very many vertices, construction can be split among multiple
+*threads* (the result doesn't depend on their number).)raw")
+    .def("evaluate", &AsdfSpline<float>::evaluate, py::arg("t").noconvert(),
 R"raw(Evaluate position at *t*.)raw")
-    .def("evaluate_velocity", &AsdfSpline<float>::evaluate_velocity, "t"_a,
+    .def("evaluate", &AsdfSpline<float>::evaluate_array, "t"_a,
+        "threads"_a = 1,
+R"raw(Evaluate positions at *t*.
+
+If *t* is a one-dimensional array of N times, an array of shape (N, 3)
+is returned.  The Python GIL is released during evaluation.  For large N,
+the work can be split among multiple *threads*.
+Evaluation is fastest if the times are sorted.)raw")
+    .def("evaluate_velocity", &AsdfSpline<float>::evaluate_velocity,
+        py::arg("t").noconvert(),
 R"raw( Evaluate velocity at *t*.)raw")
+    .def("evaluate_velocity", &AsdfSpline<float>::evaluate_velocity_array,
+        "t"_a, "threads"_a = 1,
+R"raw(Evaluate velocities at *t*, see :meth:`evaluate`.)raw")
+    .def("evaluate_at_distance",
+        &AsdfSpline<float>::evaluate_at_distance_array,
+        "s"_a, "threads"_a = 1,
+R"raw(Evaluate positions at the arc lengths *s*.
+
+See :meth:`evaluate`, but with arc lengths (measured from the beginning
+of the path) instead of times.  Sorted arc lengths are evaluated in one
+sweep along the path, which is much faster.)raw")
+    .def("sample_by_distance", &AsdfSpline<float>::sample_by_distance_array,
+        "step"_a,
+R"raw(Positions at the arc lengths 0, *step*, 2 * *step*, ...
+
+The result is an array of shape (N, 3), see :attr:`total_length`.)raw")
+    .def("evaluate_state", &AsdfSpline<float>::evaluate_state_dict, "t"_a,
+R"raw(Evaluate position, velocity and acceleration at *t*.
+
+The result is a dict with the keys ``position``, ``velocity``,
+``acceleration``, ``speed`` and ``arc_length``.  This is faster than
+calling :meth:`evaluate` and :meth:`evaluate_velocity`.)raw")
+    .def("closest_point", &AsdfSpline<float>::closest_point_dict, "point"_a,
+R"raw(Find the point on the curve that's closest to *point*.
+
+The result is a dict with the keys ``position``, ``distance``, ``time``
+and ``arc_length``.)raw")
+    .def("time_intervals_within",
+        &AsdfSpline<float>::time_intervals_within_list,
+        "point"_a, "radius"_a, "t0"_a = py::none(), "t1"_a = py::none(),
+R"raw(Find the times between *t0* and *t1* where the curve is within
+*radius* around *point*.
+
+The result is a sorted list of ``(begin, end)`` tuples.  By default,
+the whole curve is searched.)raw")
+    .def("update_vertex", &AsdfSpline<float>::update_vertex,
+        "i"_a, "position"_a,
+R"raw(Change position of vertex *i*.
+
+Only the neighborhood of the vertex is re-computed, which is much faster
+than creating a new spline.  If this raises an exception, the spline
+is not modified.  This must not be called while another thread is
+evaluating the spline.)raw")
+    .def("update_time", &AsdfSpline<float>::update_time_or_none,
+        "i"_a, "time"_a = py::none(), "speed"_a = py::none(),
+R"raw(Change (or remove) *time* and *speed* of vertex *i*.
+
+See :meth:`update_vertex`.)raw")
+    .def("update_tcb", &AsdfSpline<float>::update_tcb_values,
+        "i"_a, "tension"_a = 0, "continuity"_a = 0, "bias"_a = 0,
+R"raw(Change *tension*, *continuity* and *bias* of vertex *i*.
+
+See :meth:`update_vertex`.)raw")
+    .def("append_vertex", &AsdfSpline<float>::append_vertex_or_none,
+        "position"_a, "time"_a, "speed"_a = py::none(),
+        "tension"_a = 0, "continuity"_a = 0, "bias"_a = 0,
+R"raw(Append a vertex at *time* (later than the last time) to an open spline.
+
+*tension*, *continuity* and *bias* belong to the previously last vertex,
+which becomes an inner vertex.  Only the end of the spline is
+re-computed, the cost doesn't depend on the number of vertices.
+See :meth:`update_vertex`.)raw")
+    .def("discard_vertices", &AsdfSpline<float>::discard_vertices, "count"_a,
+R"raw(Remove the first *count* vertices of an open spline.
+
+The new first vertex must have a time.  The rest of the spline doesn't
+change, but arc lengths start at zero again.  This takes time
+proportional to the number of remaining vertices, it should be used for
+many vertices at once.)raw")
     .def_property_readonly("grid", &AsdfSpline<float>::grid_as_array)
+    .def_property_readonly("total_length", &AsdfSpline<float>::total_length,
+R"raw(Arc length of the whole path.)raw")
+    // The fully built spline is pickled, it doesn't have to be re-built
+    // (e.g. in multiprocessing workers).
+    .def(py::pickle(&AsdfSpline<float>::get_state
+                  , &AsdfSpline<float>::set_state))
     ;
 
+  m.def("instrumentation_snapshot", &instrumentation_snapshot,
+R"raw(Return counters and latency histograms (summed over all threads).
+
+The result is a dict with the keys ``enabled``, ``counters`` (a dict of
+integers) and ``latencies`` (a dict of lists, one per API function).
+Bucket 0 of each latency histogram counts calls that took less than
+1 ns, bucket i counts calls that took between 2**(i-1) and 2**i - 1 ns.
+
+Only available if the module was built with the environment variable
+ASDFSPLINE_INSTRUMENTATION=1, otherwise everything is zero.)raw");
+  m.def("reset_instrumentation", &asdf::instrumentation::reset,
+R"raw(Set all counters and histograms to zero.)raw");
+
 #ifdef VERSION_INFO
   m.attr("__version__") = VERSION_INFO;
 #else
@@ -1,3 +1,5 @@
+#pragma once
+
 /// Quick and dirty three-dimensional vector type
 
 #include <cmath>  // for std::hypot()
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "asdfspline.hpp"
+#include "vec3.hpp"
+
+using V = Vec3<float>;
+using Spline = asdf::AsdfSpline<float, V>;
+using Vertex = Spline::AsdfVertex;
+
+template<typename S, typename V>
+struct asdf::AsdfSplineInternals
+{
+  static const auto& path(const AsdfSpline<S, V>& spline)
+  {
+    return spline._path;
+  }
+
+  static const auto& t2s(const AsdfSpline<S, V>& spline)
+  {
+    return spline._t2s;
+  }
+
+  static const auto& s_grid(const AsdfSpline<S, V>& spline)
+  {
+    return spline._s_grid;
+  }
+};
+
+using Internals = asdf::AsdfSplineInternals<float, V>;
+
+/// Random walk with n vertices, every third vertex has a time (and every
+/// sixth a speed), some vertices have TCB values.
+inline std::vector<Vertex> random_vertices(size_t n, bool closed
+    , unsigned seed = 1)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> step(0, 1);
+  std::vector<Vertex> result;
+  V position{};
+  for (size_t i = 0; i < n; ++i)
+  {
+    position += V{step(rng), step(rng), step(rng)};
+    Vertex vertex{position, {}, {}, {}};
+    if (i % 3 == 0 || i == n - 1)
+    {
+      vertex.time = float(i) * 0.5f;
+    }
+    if (i % 6 == 0 && 0 < i && i < n - 1)
+    {
+      vertex.speed = 2;
+    }
+    if (i % 5 == 0 && 0 < i && i < n - 1)
+    {
+      vertex.tcb = {0.1f, -0.2f, 0.3f};
+    }
+    result.push_back(vertex);
+  }
+  if (closed)
+  {
+    result.back().position = asdf::CLOSED{};
+  }
+  return result;
+}
+
+inline bool operator==(const V& lhs, const V& rhs)
+{
+  return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z;
+}
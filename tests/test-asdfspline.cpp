@@ -0,0 +1,654 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>  // for max(), reverse(), upper_bound()
+#include <iterator>  // for back_inserter()
+#include <limits>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+#include "asdfscene.hpp"
+#include "asdfspline.hpp"
+#include "asdfsplinebuilder.hpp"
+#include "splinecursor.hpp"
+#include "common.hpp"
+
+namespace {
+
+std::vector<float> sample_times(const Spline& spline, size_t n)
+{
+  float t0 = spline.grid().front() - 1;
+  float t1 = spline.grid().back() + 1;
+  std::vector<float> result;
+  for (size_t i = 0; i < n; ++i)
+  {
+    result.push_back(t0 + (t1 - t0) * float(i) / float(n - 1));
+  }
+  return result;
+}
+
+float distance(const V& a, const V& b) { return length(a - b); }
+
+/// Position at time t, with the arc length inverted by bisection down to
+/// the resolution of float (instead of the approximations in evaluate())
+V exact_position(const Spline& spline, float t)
+{
+  const auto& path = Internals::path(spline);
+  const auto& s_grid = Internals::s_grid(spline);
+  float s = Internals::t2s(spline).evaluate(t);
+  size_t index = static_cast<size_t>(std::upper_bound(
+        s_grid.begin() + 1, s_grid.end() - 1, s) - s_grid.begin()) - 1;
+  float target = s - s_grid[index];
+  float lower = path.grid()[index];
+  float upper = path.grid()[index + 1];
+  for (;;)
+  {
+    float center = lower + (upper - lower) / 2;
+    if (!(lower < center && center < upper))
+    {
+      break;
+    }
+    (path.segment_length_to(index, center) < target ? lower : upper) = center;
+  }
+  return path.evaluate(lower);
+}
+
+/// Counts the allocations that are passed to the upstream resource
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  size_t allocations = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override
+  {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override
+  {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+}  // namespace
+
+TEST_CASE("Vertices are reached at their given times")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(31, closed);
+    for (size_t s2u_knots: {0, 4})
+    {
+      Spline spline(data, s2u_knots);
+      for (size_t i = 0; i < data.size(); ++i)
+      {
+        if (!data[i].time)
+        {
+          continue;
+        }
+        auto index = closed && i == data.size() - 1 ? 0 : i;
+        V expected = std::get<V>(data[index].position);
+        CHECK(distance(spline.evaluate(*data[i].time), expected)
+            == Approx(0).margin(1e-3));
+      }
+    }
+  }
+}
+
+TEST_CASE("Batch and cursor evaluation are the same as evaluate()")
+{
+  for (bool closed: {false, true})
+  {
+    Spline spline(random_vertices(40, closed));
+    auto times = sample_times(spline, 500);
+    std::vector<V> positions(times.size());
+    std::vector<V> velocities(times.size());
+    spline.evaluate_many(times.begin(), times.end(), positions.begin());
+    spline.evaluate_velocity_many(times.begin(), times.end()
+        , velocities.begin());
+    asdf::SplineCursor<float, V> cursor(spline);
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+      CHECK(distance(positions[i], spline.evaluate(times[i]))
+          == Approx(0).margin(1e-3));
+      CHECK(distance(velocities[i], spline.evaluate_velocity(times[i]))
+          == Approx(0).margin(1e-2));
+      CHECK(distance(cursor.seek(times[i]), positions[i])
+          == Approx(0).margin(1e-3));
+    }
+  }
+}
+
+TEST_CASE("evaluate_state() is consistent with finite differences")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(30, closed);
+    Spline spline(data);
+    const auto& grid = spline.grid();
+    for (size_t i = 0; i + 1 < grid.size(); ++i)
+    {
+      // Between vertices, the spline is smooth
+      float t = (grid[i] + grid[i + 1]) / 2;
+      auto state = spline.evaluate_state(t);
+      CHECK(state.position == spline.evaluate(t));
+      CHECK(state.velocity == spline.evaluate_velocity(t));
+      CHECK(state.speed == Approx(length(state.velocity)));
+      float h = (grid[i + 1] - grid[i]) * 0.01f;
+      auto before = spline.evaluate_state(t - h);
+      auto after = spline.evaluate_state(t + h);
+      CHECK((after.arc_length - before.arc_length) / (2 * h)
+          == Approx(state.speed).epsilon(1e-3));
+      V difference = (after.velocity - before.velocity) / (2 * h);
+      CHECK(distance(difference, state.acceleration)
+          <= 1e-2f * (1 + length(state.acceleration)));
+    }
+    auto state = spline.evaluate_state(grid.front() - 1);
+    CHECK(state.position == spline.evaluate(grid.front()));
+    CHECK(state.arc_length == 0);
+  }
+}
+
+TEST_CASE("evaluate_at_distance() is consistent with evaluate_state()")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(30, closed);
+    Spline spline(data);
+    std::vector<float> lengths;
+    std::vector<V> expected;
+    for (float t: sample_times(spline, 2000))
+    {
+      auto state = spline.evaluate_state(t);
+      lengths.push_back(state.arc_length);
+      expected.push_back(state.position);
+    }
+    // Sorted, with repetitions, and in reverse
+    for (bool reverse: {false, true})
+    {
+      if (reverse)
+      {
+        std::reverse(lengths.begin(), lengths.end());
+        std::reverse(expected.begin(), expected.end());
+      }
+      std::vector<V> positions(lengths.size());
+      auto end = spline.evaluate_at_distance(
+          lengths.begin(), lengths.end(), positions.begin());
+      CHECK(end == positions.end());
+      for (size_t i = 0; i < positions.size(); ++i)
+      {
+        CHECK(distance(positions[i], expected[i]) == Approx(0).margin(1e-3));
+      }
+    }
+  }
+}
+
+TEST_CASE("sample_by_distance() gives evenly spaced points")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(30, closed);
+    Spline spline(data);
+    for (float step: {0.01f, 0.7f, 100.0f})
+    {
+      std::vector<V> positions;
+      spline.sample_by_distance(step, std::back_inserter(positions));
+      auto total = spline.total_length();
+      REQUIRE(positions.size() == size_t(total / step) + 1);
+      CHECK(positions.front() == spline.evaluate(spline.grid().front()));
+      std::vector<float> lengths;
+      for (size_t i = 0; i < positions.size(); ++i)
+      {
+        lengths.push_back(float(i) * step);
+      }
+      std::vector<V> expected(lengths.size());
+      spline.evaluate_at_distance(
+          lengths.begin(), lengths.end(), expected.begin());
+      CHECK(positions == expected);
+      for (size_t i = 1; i < positions.size(); ++i)
+      {
+        // Chords are at most as long as the arcs (up to the accuracy
+        // of the arc length inversion)
+        CHECK(distance(positions[i - 1], positions[i]) <= step + 1e-3f);
+      }
+    }
+    std::vector<V> positions;
+    CHECK_THROWS_AS(spline.sample_by_distance(0, positions.begin())
+        , std::runtime_error);
+  }
+}
+
+TEST_CASE("closest_point() is at least as close as dense sampling")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(40, closed);
+    Spline spline(data);
+    auto times = sample_times(spline, 20000);
+    std::mt19937 rng(3);
+    std::normal_distribution<float> coordinate(0, 3);
+    for (size_t i = 0; i < 20; ++i)
+    {
+      V point{coordinate(rng), coordinate(rng), coordinate(rng)};
+      auto closest = spline.closest_point(point);
+      CHECK(closest.distance == Approx(distance(closest.position, point)));
+      CHECK(distance(spline.evaluate(closest.time), closest.position)
+          == Approx(0).margin(1e-3));
+      float sampled = std::numeric_limits<float>::infinity();
+      for (float t: times)
+      {
+        sampled = std::min(sampled, distance(spline.evaluate(t), point));
+      }
+      CHECK(closest.distance <= sampled + 1e-4f);
+      CHECK(closest.distance == Approx(sampled).margin(1e-2));
+    }
+  }
+}
+
+TEST_CASE("time_intervals_within() is consistent with evaluate()")
+{
+  for (bool closed: {false, true})
+  {
+    auto data = random_vertices(40, closed);
+    Spline spline(data);
+    auto times = sample_times(spline, 5000);
+    for (size_t i = 0; i < data.size() - 1; i += 7)
+    {
+      V point = std::get<V>(data[i].position);
+      float radius = 2;
+      // The curve passes through its vertices
+      CHECK_FALSE(spline.time_intervals_within(point, radius).empty());
+      for (auto [t0, t1]: {std::pair{times.front(), times.back()}
+                         , std::pair{3.0f, 11.0f}})
+      {
+        auto intervals = spline.time_intervals_within(point, radius, t0, t1);
+        for (size_t j = 0; j < intervals.size(); ++j)
+        {
+          CHECK(t0 <= intervals[j].first);
+          CHECK(intervals[j].first <= intervals[j].second);
+          CHECK(intervals[j].second <= t1);
+          if (j > 0)
+          {
+            CHECK(intervals[j - 1].second < intervals[j].first);
+          }
+        }
+        for (float t: times)
+        {
+          if (t < t0 || t1 < t)
+          {
+            continue;
+          }
+          bool inside = false;
+          for (auto [begin, end]: intervals)
+          {
+            inside = inside || (begin <= t && t <= end);
+          }
+          auto d = distance(spline.evaluate(t), point);
+          if (d < radius * 0.999f)
+          {
+            CHECK(inside);
+          }
+          else if (d > radius * 1.001f)
+          {
+            CHECK_FALSE(inside);
+          }
+        }
+      }
+    }
+    CHECK(spline.time_intervals_within(V{1000, 0, 0}, 1).empty());
+  }
+}
+
+TEST_CASE("AsdfScene is the same as SplineCursor")
+{
+  asdf::AsdfScene<float, V> scene(2);
+  std::vector<asdf::SplineCursor<float, V>> cursors;
+  for (unsigned seed = 1; seed <= 20; ++seed)
+  {
+    scene.add(random_vertices(10 + seed, seed % 2, seed));
+  }
+  for (size_t i = 0; i < scene.size(); ++i)
+  {
+    cursors.emplace_back(scene[i]);
+  }
+  std::vector<V> positions(scene.size());
+  std::vector<V> velocities(scene.size());
+  for (float t = -1; t < 20; t += 0.37f)
+  {
+    scene.evaluate_all(t, positions.begin(), velocities.begin());
+    for (size_t i = 0; i < scene.size(); ++i)
+    {
+      CHECK(positions[i] == cursors[i].seek(t));
+      CHECK(velocities[i] == cursors[i].evaluate_velocity());
+    }
+  }
+}
+
+TEST_CASE("Construction with threads gives identical results")
+{
+  auto data = random_vertices(3000, true);
+  Spline single(data, 4, 1);
+  Spline multi(data, 4, 3);
+  // Not thread-safe
+  std::pmr::monotonic_buffer_resource arena;
+  Spline shared(data, 4, 3, &arena);
+  REQUIRE(single.grid() == multi.grid());
+  REQUIRE(single.grid() == shared.grid());
+  for (float t: sample_times(single, 1000))
+  {
+    CHECK(single.evaluate(t) == multi.evaluate(t));
+    CHECK(single.evaluate_velocity(t) == multi.evaluate_velocity(t));
+    CHECK(single.evaluate(t) == shared.evaluate(t));
+  }
+}
+
+TEST_CASE("Number of allocations doesn't depend on number of vertices")
+{
+  for (bool closed: {false, true})
+  {
+    std::vector<size_t> counts;
+    for (size_t n: {10, 100, 1000})
+    {
+      auto data = random_vertices(n, closed);
+      CountingResource resource;
+      Spline spline(data, 0, 1, &resource);
+      counts.push_back(resource.allocations);
+
+      Spline expected(data);
+      REQUIRE(spline.grid() == expected.grid());
+      for (float t: sample_times(spline, 100))
+      {
+        CHECK(spline.evaluate(t) == expected.evaluate(t));
+      }
+    }
+    CHECK(counts[0] == counts[1]);
+    CHECK(counts[1] == counts[2]);
+  }
+}
+
+TEST_CASE("Splines in a scene can share a monotonic buffer")
+{
+  std::pmr::monotonic_buffer_resource arena;
+  asdf::AsdfScene<float, V> scene;
+  std::vector<Spline> expected;
+  for (unsigned seed = 1; seed <= 5; ++seed)
+  {
+    auto data = random_vertices(50, seed % 2, seed);
+    scene.add(data, 4, 1, &arena);
+    expected.emplace_back(data, 4);
+  }
+  std::vector<V> positions(scene.size());
+  for (float t: {0.0f, 3.3f, 10.0f, 24.5f})
+  {
+    scene.evaluate_all(t, positions.begin());
+    for (size_t i = 0; i < scene.size(); ++i)
+    {
+      CHECK(positions[i] == expected[i].evaluate(t));
+    }
+  }
+}
+
+TEST_CASE("render_block() is close to evaluate()")
+{
+  Spline spline(random_vertices(20, false));
+  float sample_rate = 100;
+  float t_start = -0.5f;
+  std::vector<V> block(1500);
+  spline.render_block(t_start, sample_rate, block.size(), block.begin()
+      , 0.0001f);
+  for (size_t i = 0; i < block.size(); ++i)
+  {
+    float t = t_start + float(i) / sample_rate;
+    CHECK(distance(block[i], spline.evaluate(t)) == Approx(0).margin(1e-3));
+  }
+}
+
+TEST_CASE("bake() stays within tolerance")
+{
+  std::vector<Spline> splines;
+  splines.emplace_back(random_vertices(30, false));
+  splines.emplace_back(random_vertices(30, true));
+  // Hairpin turn with an almost vanishing path velocity
+  splines.emplace_back(std::vector<Vertex>{
+      {V{0, 0, 0}, 0.0f, {}, {}},
+      {V{10, 0, 0}, 2.0f, {}, {-0.3f, 0.2f, -0.9f}},
+      {V{10.5f, -0.5f, 0}, 3.0f, {}, {-0.7f, 0.9f, -0.9f}},
+      {V{0, 10, 0}, 5.0f, {}, {}}});
+  for (const auto& spline: splines)
+  {
+    for (float tolerance: {0.01f, 0.001f})
+    {
+      auto baked = spline.bake(tolerance);
+      CHECK(baked.grid().front() == spline.grid().front());
+      CHECK(baked.grid().back() == spline.grid().back());
+      float t0 = spline.grid().front();
+      float t1 = spline.grid().back();
+      float max_distance = 0;
+      size_t n = 20000;
+      for (size_t i = 0; i <= n; ++i)
+      {
+        float t = t0 + (t1 - t0) * float(i) / float(n);
+        max_distance = std::max(max_distance
+            , distance(baked.evaluate(t), exact_position(spline, t)));
+      }
+      CHECK(max_distance <= tolerance);
+    }
+  }
+}
+
+TEST_CASE("update_time() and update_vertex() are the same as re-building")
+{
+  auto data = random_vertices(25, false);
+  Spline spline(data, 4);
+
+  data[4].time = 2.5f;
+  data[7].time.reset();
+  data[10].position = V{1, 2, 3};
+  spline.update_time(4, data[4].time, data[4].speed);
+  spline.update_time(7, data[7].time);
+  spline.update_vertex(10, std::get<V>(data[10].position));
+
+  Spline expected(data, 4);
+  REQUIRE(spline.grid().size() == expected.grid().size());
+  for (float t: sample_times(expected, 500))
+  {
+    CHECK(distance(spline.evaluate(t), expected.evaluate(t))
+        == Approx(0).margin(1e-3));
+  }
+  // Search structures have been updated as well
+  for (auto point: {V{1, 2, 3}, V{-1, 0, 2}})
+  {
+    CHECK(spline.closest_point(point).distance
+        == Approx(expected.closest_point(point).distance).margin(1e-4));
+  }
+}
+
+TEST_CASE("AsdfSpline::append_vertex() is the same as re-building")
+{
+  auto data = random_vertices(40, false);
+  for (size_t i = 10; i < data.size(); ++i)
+  {
+    data[i].time = float(i) * 0.5f;
+    data[i].speed.reset();
+  }
+  data.back().tcb = {};
+  for (size_t s2u_knots: {0, 4})
+  {
+    std::vector<Vertex> prefix(data.begin(), data.begin() + 10);
+    prefix.back().tcb = {};
+    Spline spline(prefix, s2u_knots);
+    for (size_t i = 10; i < data.size(); ++i)
+    {
+      spline.append_vertex(std::get<V>(data[i].position), *data[i].time
+          , data[i].speed, data[i - 1].tcb);
+    }
+    Spline expected(data, s2u_knots);
+    REQUIRE(spline.grid().size() == expected.grid().size());
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      CHECK(spline.grid()[i] == Approx(expected.grid()[i]).margin(1e-4));
+    }
+    for (float t: sample_times(expected, 500))
+    {
+      CHECK(distance(spline.evaluate(t), expected.evaluate(t))
+          == Approx(0).margin(1e-3));
+    }
+    CHECK(spline.total_length() == Approx(expected.total_length()));
+    V point{1, 2, 3};
+    CHECK(spline.closest_point(point).distance
+        == Approx(expected.closest_point(point).distance).margin(1e-4));
+    CHECK(spline.time_intervals_within(point, 2).size()
+        == expected.time_intervals_within(point, 2).size());
+  }
+}
+
+TEST_CASE("discard_vertices() keeps the remaining part")
+{
+  auto data = random_vertices(30, false);
+  Spline spline(data, 4);
+  auto times = sample_times(spline, 200);
+  std::vector<V> before(times.size());
+  spline.evaluate_many(times.begin(), times.end(), before.begin());
+
+  // Vertex 5 doesn't have a time
+  CHECK_THROWS_AS(spline.discard_vertices(5), std::runtime_error);
+  CHECK_THROWS_AS(spline.discard_vertices(29), std::out_of_range);
+  spline.discard_vertices(6);
+  REQUIRE(spline.grid().size() == 24);
+  CHECK(spline.grid().front() == *data[6].time);
+  CHECK(spline.evaluate_state(*data[6].time).arc_length == 0);
+  for (size_t i = 0; i < times.size(); ++i)
+  {
+    if (times[i] >= spline.grid().front())
+    {
+      CHECK(distance(spline.evaluate(times[i]), before[i])
+          == Approx(0).margin(1e-3));
+    }
+  }
+  // Appending still works
+  spline.append_vertex(V{0, 0, 0}, spline.grid().back() + 1);
+  CHECK(distance(spline.evaluate(spline.grid().back()), V{0, 0, 0})
+      == Approx(0).margin(1e-5));
+}
+
+TEST_CASE("AsdfSplineBuilder with and without window")
+{
+  asdf::AsdfSplineBuilder<float, V> full;
+  asdf::AsdfSplineBuilder<float, V> windowed(5.0f);
+  CHECK_THROWS_AS(full.append_vertex(V{}, 0, {}, {0.1f, 0, 0})
+      , std::runtime_error);
+  std::mt19937 rng(2);
+  std::normal_distribution<float> step(0, 1);
+  V position{};
+  for (size_t i = 0; i < 200; ++i)
+  {
+    position += V{step(rng), step(rng), step(rng)};
+    float time = float(i) * 0.5f;
+    std::array<float, 3> tcb{0, 0, (i % 4 == 0) ? 0.2f : 0.0f};
+    if (i == 0)
+    {
+      tcb = {};
+    }
+    full.append_vertex(position, time, std::nullopt, tcb);
+    windowed.append_vertex(position, time, std::nullopt, tcb);
+    if (i == 0)
+    {
+      CHECK(windowed.spline() == nullptr);
+      continue;
+    }
+    const auto& grid = windowed.spline()->grid();
+    CHECK(grid.back() == time);
+    CHECK(grid.front() <= std::max(time - 5.0f, 0.0f));
+    // At most twice the window (and the vertex before it)
+    CHECK(grid.size() <= 2 * 11 + 1);
+  }
+  const auto& spline = *windowed.spline();
+  for (float t = spline.grid().front(); t < spline.grid().back(); t += 0.01f)
+  {
+    CHECK(distance(spline.evaluate(t), full.spline()->evaluate(t))
+        == Approx(0).margin(1e-3));
+  }
+
+  // Invalid vertices don't change anything
+  auto copy = spline;
+  CHECK_THROWS(windowed.append_vertex(position, 200));
+  CHECK_THROWS(windowed.append_vertex(V{}, 99));
+  // Speed too high
+  CHECK_THROWS(windowed.append_vertex(V{}, 200, 1000.0f));
+  REQUIRE(spline.grid().size() == copy.grid().size());
+  for (float t = spline.grid().front(); t < spline.grid().back(); t += 0.1f)
+  {
+    CHECK(spline.evaluate(t) == copy.evaluate(t));
+  }
+}
+
+TEST_CASE("Invalid updates leave the spline unchanged")
+{
+  auto data = random_vertices(10, false);
+  Spline spline(data);
+  auto times = sample_times(spline, 100);
+  std::vector<V> before(times.size());
+  spline.evaluate_many(times.begin(), times.end(), before.begin());
+
+  CHECK_THROWS_AS(spline.update_time(10, 1.0f), std::out_of_range);
+  CHECK_THROWS_AS(spline.update_time(9, std::nullopt), std::runtime_error);
+  CHECK_THROWS_AS(spline.update_time(2, std::nullopt, 1.0f)
+      , std::runtime_error);
+  // Non-increasing time
+  CHECK_THROWS_AS(spline.update_time(6, 0.5f), std::runtime_error);
+
+  std::vector<V> after(times.size());
+  spline.evaluate_many(times.begin(), times.end(), after.begin());
+  CHECK(before == after);
+}
+
+TEST_CASE("Failed update_vertex() and update_tcb() leave the spline unchanged")
+{
+  std::vector<Vertex> data{
+      {V{0, 0, 0}, 0.0f, {}, {}},
+      {V{1, 0, 0}, 1.0f, 1.0f, {}},
+      {V{2, 1, 0}, {}, {}, {}},
+      {V{3, 0, 0}, 3.0f, {}, {}},
+      {V{4, 1, 0}, 4.0f, {}, {}}};
+  Spline spline(data, 4);
+  auto times = sample_times(spline, 100);
+  std::vector<V> before(times.size());
+  spline.evaluate_many(times.begin(), times.end(), before.begin());
+  auto grid = spline.grid();
+
+  // The speed at vertex 1 is too steep for the shortened arc length
+  CHECK_THROWS_AS(spline.update_vertex(0, V{0.99f, 0, 0}), std::runtime_error);
+  CHECK_THROWS_AS(spline.update_vertex(5, V{}), std::out_of_range);
+  CHECK_THROWS_AS(spline.update_tcb(0, {}), std::out_of_range);
+
+  CHECK(spline.grid() == grid);
+  std::vector<V> after(times.size());
+  spline.evaluate_many(times.begin(), times.end(), after.begin());
+  for (size_t i = 0; i < times.size(); ++i)
+  {
+    CHECK(distance(before[i], after[i]) == Approx(0).margin(1e-5));
+  }
+  // Search structures are still valid
+  auto closest = spline.closest_point(V{2, 1, 0});
+  CHECK(closest.distance == Approx(0).margin(1e-5));
+}
+
+TEST_CASE("Invalid vertex data")
+{
+  std::vector<Vertex> data{{V{0, 0, 0}, {}, {}, {}}};
+  CHECK_THROWS_AS(Spline(data), std::runtime_error);
+  data.push_back({V{1, 0, 0}, {}, {}, {}});
+  // Time of last vertex is missing
+  CHECK_THROWS_AS(Spline(data), std::runtime_error);
+  data.back().time = 1;
+  CHECK_NOTHROW(Spline(data));
+  data.back().time = -1;
+  CHECK_THROWS_AS(Spline(data), std::runtime_error);
+}
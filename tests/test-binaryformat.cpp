@@ -0,0 +1,139 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>  // for swap_ranges()
+#include <cstdint>
+#include <cstring>  // for memcpy()
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "binaryformat.hpp"
+#include "common.hpp"
+
+TEST_CASE("Values are restored")
+{
+  asdf::BinaryWriter<float> writer;
+  writer.write(std::uint32_t(0x01020304));
+  writer.write(true);
+  writer.write(-2.5f);
+  writer.write(V{1, 2, 3});
+  writer.write(std::optional<float>{});
+  writer.write(std::optional<float>{4.5f});
+  writer.write(std::vector<V>{{1, 2, 3}, {4, 5, 6}});
+  writer.write(std::vector<std::array<float, 3>>{{7, 8, 9}});
+  const auto& data = writer.data();
+  // Little-endian independent of the host
+  CHECK(data.substr(0, 4) == std::string("\x04\x03\x02\x01"));
+
+  asdf::BinaryReader<float> reader(data.data(), data.size());
+  CHECK(reader.read<std::uint32_t>() == 0x01020304);
+  CHECK(reader.read<bool>());
+  CHECK(reader.read<float>() == -2.5f);
+  CHECK(reader.read<V>() == V{1, 2, 3});
+  CHECK(!reader.read<std::optional<float>>());
+  CHECK(reader.read<std::optional<float>>() == 4.5f);
+  CHECK(reader.read<std::vector<V>>() == std::vector<V>{{1, 2, 3}, {4, 5, 6}});
+  CHECK(reader.read<std::vector<std::array<float, 3>>>()
+      == std::vector<std::array<float, 3>>{{7, 8, 9}});
+  CHECK(reader.remaining() == 0);
+  CHECK_THROWS_AS(reader.read<std::uint8_t>(), std::runtime_error);
+}
+
+TEST_CASE("Vectors of optional values are stored element-wise")
+{
+  asdf::BinaryWriter<float> writer;
+  writer.write(std::vector<std::optional<float>>{1.0f, std::nullopt});
+  const auto& data = writer.data();
+  // Size, flag and value, flag
+  CHECK(data == std::string("\x02\0\0\0\0\0\0\0" "\x01" "\0\0\x80\x3f"
+        "\0", 14));
+
+  asdf::BinaryReader<float> reader(data.data(), data.size());
+  auto values = reader.read<std::vector<std::optional<float>>>();
+  REQUIRE(values.size() == 2);
+  CHECK(values[0] == 1.0f);
+  CHECK(!values[1]);
+  CHECK(reader.remaining() == 0);
+}
+
+TEST_CASE("Saved splines are restored exactly")
+{
+  for (size_t s2u_knots: {0, 4})
+  {
+    Spline spline(random_vertices(50, s2u_knots != 0), s2u_knots);
+    asdf::BinaryWriter<float> writer;
+    spline.save(writer);
+    const auto& data = writer.data();
+    asdf::BinaryReader<float> reader(data.data(), data.size());
+    Spline restored(reader);
+    CHECK(reader.remaining() == 0);
+    CHECK(restored.grid() == spline.grid());
+    for (float t = -1; t < 30; t += 0.1f)
+    {
+      CHECK(restored.evaluate(t) == spline.evaluate(t));
+      CHECK(restored.evaluate_velocity(t) == spline.evaluate_velocity(t));
+    }
+  }
+}
+
+TEST_CASE("Invalid binary data")
+{
+  Spline spline(random_vertices(10, false));
+  asdf::BinaryWriter<float> writer;
+  spline.save(writer);
+  auto data = writer.data();
+
+  for (size_t size: {size_t(0), size_t(7), data.size() / 2, data.size() - 1})
+  {
+    asdf::BinaryReader<float> reader(data.data(), size);
+    CHECK_THROWS_AS(Spline(reader), std::runtime_error);
+  }
+
+  auto corrupted = data;
+  corrupted[0] = 'X';
+  asdf::BinaryReader<float> reader1(corrupted.data(), corrupted.size());
+  CHECK_THROWS_AS(Spline(reader1), std::runtime_error);
+
+  asdf::BinaryReader<double> reader2(data.data(), data.size());
+  CHECK_THROWS_AS((asdf::AsdfSpline<double, Vec3<double>>(reader2))
+      , std::runtime_error);
+}
+
+TEST_CASE("Unsorted and non-finite grids are rejected")
+{
+  Spline spline(random_vertices(10, false), 4);
+  asdf::BinaryWriter<float> writer;
+  spline.save(writer);
+  const auto& data = writer.data();
+
+  // Times (including the ones that are not given) and arc lengths of all
+  // vertices, the latter are stored twice (in the path and in the spline)
+  for (const auto& grid: {spline.grid(), Internals::s_grid(spline)})
+  {
+    REQUIRE(grid.size() == 10);
+    asdf::BinaryWriter<float> grid_writer;
+    grid_writer.write(grid);
+    const auto& bytes = grid_writer.data();
+    size_t occurrences = 0;
+    for (auto position = data.find(bytes); position != std::string::npos
+        ; position = data.find(bytes, position + 1))
+    {
+      ++occurrences;
+      // Elements 1 and 2 are swapped, then element 1 is set to NaN
+      auto element = [position](size_t i) { return position + 8 + 4 * i; };
+      auto unsorted = data;
+      std::swap_ranges(unsorted.begin() + element(1)
+          , unsorted.begin() + element(2), unsorted.begin() + element(2));
+      auto nan = data;
+      float value = std::numeric_limits<float>::quiet_NaN();
+      std::memcpy(nan.data() + element(1), &value, 4);
+      for (const auto* corrupted: {&unsorted, &nan})
+      {
+        asdf::BinaryReader<float> reader(corrupted->data(), corrupted->size());
+        CHECK_THROWS_AS(Spline(reader), std::runtime_error);
+      }
+    }
+    CHECK(occurrences >= 1);
+  }
+}
@@ -0,0 +1,209 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <vector>
+
+#include "centripetalkochanekbartelsspline.hpp"
+#include "common.hpp"
+
+using Curve = asdf::CentripetalKochanekBartelsSpline<float, V>;
+using TCB = std::array<float, 3>;
+
+TEST_CASE("Curve passes through its vertices")
+{
+  std::vector<V> vertices{{0, 0, 0}, {1, 2, 0}, {3, 1, -1}, {4, 4, 2}};
+  for (bool closed: {false, true})
+  {
+    std::vector<TCB> tcb(closed ? 4 : 2, TCB{0.2f, 0.1f, -0.3f});
+    Curve curve(vertices, tcb, closed);
+    const auto& grid = curve.grid();
+    REQUIRE(grid.size() == vertices.size() + closed);
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+      V difference = curve.evaluate(grid[i]) - vertices[i % vertices.size()];
+      CHECK(length(difference) == Approx(0).margin(1e-5));
+    }
+  }
+}
+
+TEST_CASE("evaluate_derivatives() matches evaluate() and evaluate_velocity()")
+{
+  auto data = random_vertices(20, true);
+  std::vector<V> vertices;
+  for (const auto& vertex: data)
+  {
+    if (auto position = std::get_if<V>(&vertex.position))
+    {
+      vertices.push_back(*position);
+    }
+  }
+  Curve curve(vertices, std::vector<TCB>(vertices.size()), true);
+  const auto& grid = curve.grid();
+  size_t index = 0;
+  for (size_t i = 0; i + 1 < grid.size(); ++i)
+  {
+    for (float x: {0.1f, 0.5f, 0.9f})
+    {
+      float t = grid[i] + (grid[i + 1] - grid[i]) * x;
+      auto [position, velocity, acceleration] = curve.evaluate_derivatives(t);
+      CHECK(position == curve.evaluate(t));
+      CHECK(velocity == curve.evaluate_velocity(t));
+      CHECK(curve.evaluate_derivatives(t, index)[2] == acceleration);
+      CHECK(index == i);
+      // The velocity is quadratic, the central difference is exact
+      float h = (grid[i + 1] - grid[i]) * 0.05f;
+      V difference = (curve.evaluate_velocity(t + h)
+          - curve.evaluate_velocity(t - h)) / (2 * h);
+      CHECK(length(difference - acceleration)
+          == Approx(0).margin(1e-3 * (1 + length(acceleration))));
+    }
+  }
+}
+
+TEST_CASE("Arc lengths of a straight line")
+{
+  std::vector<V> vertices{{0, 0, 0}, {1, 0, 0}, {3, 0, 0}, {6, 0, 0}};
+  Curve curve(vertices, std::vector<TCB>(2), false);
+  CHECK(curve.cumulative_length(3) == Approx(6));
+  const auto& grid = curve.grid();
+  for (size_t i = 0; i < 3; ++i)
+  {
+    CHECK(curve.segment_length_to(i, grid[i + 1])
+        == Approx(curve.cumulative_length(i + 1) - curve.cumulative_length(i)));
+  }
+  CHECK(curve.segment_length_to(0, grid[0]) == 0);
+}
+
+TEST_CASE("segment_length_to() is consistent with quadrature")
+{
+  auto data = random_vertices(20, false);
+  Spline spline(data);
+  std::vector<V> vertices;
+  for (const auto& vertex: data)
+  {
+    vertices.push_back(std::get<V>(vertex.position));
+  }
+  Curve curve(vertices, std::vector<TCB>(18), false);
+  const auto& grid = curve.grid();
+  for (size_t i = 0; i < grid.size() - 1; ++i)
+  {
+    for (float x: {0.1f, 0.3f, 0.55f, 0.9f})
+    {
+      float t = grid[i] + (grid[i + 1] - grid[i]) * x;
+      auto reference = curve.adaptive_segment_length(i, grid[i], t, 1e-6f);
+      CHECK(curve.segment_length_to(i, t)
+          == Approx(reference.value).margin(1e-3));
+    }
+  }
+}
+
+TEST_CASE("Pre-computed lengths are accurate for sharp turns")
+{
+  // The speed in the middle segment almost vanishes (hairpin turn),
+  // 13-point Gauss-Legendre is off by about 1% for the whole segment
+  // (and 1e-4 with 4 sub-intervals)
+  std::vector<V> vertices{{0, 0, 0}, {10, 0, 0}, {10.5f, -0.5f, 0}, {0, 10, 0}};
+  std::vector<TCB> tcb{{-0.3f, 0.2f, -0.9f}, {-0.7f, 0.9f, -0.9f}};
+  Curve curve(vertices, tcb, false);
+  const auto& grid = curve.grid();
+  double reference = 0;
+  size_t n = 1000;
+  for (size_t k = 0; k < n; ++k)
+  {
+    float a = grid[1] + (grid[2] - grid[1]) * float(k) / float(n);
+    float b = (k + 1 < n)
+      ? grid[1] + (grid[2] - grid[1]) * float(k + 1) / float(n) : grid[2];
+    reference += curve.segment_length(1, a, b);
+  }
+  CHECK(curve.segment_length_to(1, grid[2])
+      == Approx(reference).epsilon(1e-6));
+  CHECK(curve.cumulative_length(2) - curve.cumulative_length(1)
+      == Approx(reference).epsilon(1e-6));
+}
+
+TEST_CASE("update_vertex() and update_tcb() are the same as re-building")
+{
+  std::vector<V> vertices{
+    {0, 0, 0}, {1, 2, 0}, {3, 1, -1}, {4, 4, 2}, {2, 5, 1}, {0, 3, 0}};
+  for (bool closed: {false, true})
+  {
+    std::vector<TCB> tcb(closed ? 6 : 4);
+    Curve curve(vertices, tcb, closed);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+      vertices[i] += V{0.5f, -0.25f, 0.125f};
+      curve.update_vertex(i, vertices[i]);
+      if (closed || (0 < i && i < vertices.size() - 1))
+      {
+        TCB values{0.1f * float(i), -0.2f, 0.3f};
+        tcb[closed ? i : i - 1] = values;
+        curve.update_tcb(i, values);
+      }
+      Curve expected(vertices, tcb, closed);
+      const auto& grid = expected.grid();
+      REQUIRE(curve.grid().size() == grid.size());
+      for (size_t j = 0; j < grid.size(); ++j)
+      {
+        CHECK(curve.grid()[j] == Approx(grid[j]).margin(1e-5));
+        CHECK(curve.cumulative_length(j)
+            == Approx(expected.cumulative_length(j)).margin(1e-4));
+      }
+      for (float t = 0; t < grid.back(); t += 0.1f)
+      {
+        CHECK(length(curve.evaluate(t) - expected.evaluate(t))
+            == Approx(0).margin(1e-4));
+      }
+    }
+    CHECK_THROWS_AS(curve.update_vertex(vertices.size(), V{}), std::out_of_range);
+    CHECK_THROWS(curve.update_vertex(1, vertices[2]));
+  }
+}
+
+TEST_CASE("append_vertex() and remove_last_vertex() are the same as re-building")
+{
+  std::vector<V> vertices{{0, 0, 0}, {1, 2, 0}};
+  std::vector<TCB> tcb;
+  Curve curve(vertices, tcb, false);
+  std::vector<V> more{{3, 1, -1}, {4, 4, 2}, {2, 5, 1}, {0, 3, 0}};
+  for (const auto& vertex: more)
+  {
+    TCB values{0.1f * float(tcb.size()), -0.2f, 0.3f};
+    auto changed = curve.append_vertex(vertex, values);
+    vertices.push_back(vertex);
+    tcb.push_back(values);
+    CHECK(changed.back() == vertices.size() - 2);
+    Curve expected(vertices, tcb, false);
+    const auto& grid = expected.grid();
+    REQUIRE(curve.grid().size() == grid.size());
+    for (size_t j = 0; j < grid.size(); ++j)
+    {
+      CHECK(curve.grid()[j] == Approx(grid[j]).margin(1e-5));
+      CHECK(curve.cumulative_length(j)
+          == Approx(expected.cumulative_length(j)).margin(1e-4));
+    }
+    for (float t = 0; t < grid.back(); t += 0.1f)
+    {
+      CHECK(length(curve.evaluate(t) - expected.evaluate(t))
+          == Approx(0).margin(1e-4));
+    }
+  }
+  CHECK_THROWS(curve.append_vertex(vertices.back(), TCB{}));
+
+  curve.remove_last_vertex();
+  vertices.pop_back();
+  tcb.pop_back();
+  Curve expected(vertices, tcb, false);
+  CHECK(curve.grid().back() == Approx(expected.grid().back()));
+  CHECK(length(curve.evaluate(1.5f) - expected.evaluate(1.5f))
+      == Approx(0).margin(1e-4));
+
+  // The remaining segments keep their shape, arc lengths start at zero
+  auto u = curve.grid()[2] + 0.25f;
+  auto position = curve.evaluate(u);
+  auto s = curve.cumulative_length(3) - curve.cumulative_length(2);
+  curve.erase_front(2);
+  CHECK(curve.grid().size() == vertices.size() - 2);
+  CHECK(curve.evaluate(u) == position);
+  CHECK(curve.cumulative_length(0) == 0);
+  CHECK(curve.cumulative_length(1) == Approx(s));
+}
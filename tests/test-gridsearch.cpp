@@ -0,0 +1,86 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>  // for sort()
+#include <random>
+#include <vector>
+
+#include "gridsearch.hpp"
+
+namespace {
+
+/// Expected result, see find_segment()
+size_t reference(const std::vector<float>& grid, float value)
+{
+  return std::upper_bound(grid.begin(), grid.end(), value) - grid.begin() - 1;
+}
+
+}  // namespace
+
+TEST_CASE("GridIndex finds the same segments as a binary search")
+{
+  std::mt19937 rng(1);
+  std::exponential_distribution<float> clustered(1);
+
+  std::vector<std::vector<float>> grids{
+    {0, 1},
+    {-2, -1, 7},
+    // Repeated values
+    {0, 1, 1, 1, 2, 3, 3},
+    {4, 4, 4, 5},
+  };
+  std::vector<float> random(1000);
+  for (auto& value: random)
+  {
+    // Very non-uniform
+    value = clustered(rng) * clustered(rng) * clustered(rng);
+  }
+  std::sort(random.begin(), random.end());
+  grids.push_back(random);
+
+  for (const auto& grid: grids)
+  {
+    asdf::GridIndex<float> index;
+    index.build(grid);
+    std::vector<float> values(grid.begin(), grid.end() - 1);
+    for (size_t i = 0; i < 1000; ++i)
+    {
+      auto t = grid.front() + (grid.back() - grid.front()) * float(i) / 1000;
+      values.push_back(t);
+    }
+    std::uniform_int_distribution<size_t> random_hint(0, grid.size() - 2);
+    size_t hint = 0;
+    for (float value: values)
+    {
+      if (value < grid.front() || grid.back() <= value)
+      {
+        continue;
+      }
+      auto expected = reference(grid, value);
+      CHECK(index.find(grid, value) == expected);
+      // Previous segment (for sorted values) and random segment as hint
+      hint = index.find(grid, value, hint);
+      CHECK(hint == expected);
+      CHECK(index.find(grid, value, random_hint(rng)) == expected);
+      CHECK(asdf::find_segment(grid, value, 0) == expected);
+    }
+  }
+}
+
+TEST_CASE("GridIndex::update() after changing the end of the grid")
+{
+  std::vector<float> grid{0, 1};
+  asdf::GridIndex<float> index;
+  index.build(grid);
+  for (size_t i = 2; i < 300; ++i)
+  {
+    // Change the last value and append a new one
+    grid.back() += 0.5f;
+    grid.push_back(grid.back() + 1 / float(i));
+    index.update(grid, grid.size() - 2);
+    for (float value: {0.0f, grid[i / 2] + 0.01f, grid[i - 1]
+        , grid.back() - 0.001f})
+    {
+      CHECK(index.find(grid, value) == reference(grid, value));
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+
+#include <numeric>  // for accumulate()
+#include <thread>
+
+#include "instrumentation.hpp"
+#include "monotonecubicspline.hpp"
+#include "common.hpp"
+
+namespace instr = asdf::instrumentation;
+
+namespace {
+
+std::uint64_t calls(const instr::Snapshot& snapshot, instr::Api api)
+{
+  const auto& histogram = snapshot[api];
+  return std::accumulate(histogram.begin(), histogram.end(), std::uint64_t(0));
+}
+
+}  // namespace
+
+TEST_CASE("Evaluation is counted")
+{
+  static_assert(instr::enabled);
+  Spline spline(random_vertices(20, false));
+  instr::reset();
+  for (int i = 0; i < 10; ++i)
+  {
+    spline.evaluate(float(i));
+  }
+  spline.evaluate_velocity(1.5f);
+  auto snapshot = instr::snapshot();
+  CHECK(calls(snapshot, instr::Api::evaluate) == 10);
+  CHECK(calls(snapshot, instr::Api::evaluate_velocity) == 1);
+  CHECK(calls(snapshot, instr::Api::render_block) == 0);
+  CHECK(snapshot[instr::Counter::s2u_calls] == 11);
+  CHECK(snapshot[instr::Counter::s2u_iterations] > 0);
+  CHECK(snapshot[instr::Counter::s2u_max_iterations] > 0);
+  CHECK(snapshot[instr::Counter::s2u_max_iterations]
+      <= snapshot[instr::Counter::s2u_iterations]);
+  CHECK(snapshot[instr::Counter::quadratures]
+      >= snapshot[instr::Counter::s2u_iterations]);
+  CHECK(snapshot[instr::Counter::segment_lookups] > 0);
+
+  instr::reset();
+  snapshot = instr::snapshot();
+  CHECK(snapshot[instr::Counter::s2u_calls] == 0);
+  CHECK(calls(snapshot, instr::Api::evaluate) == 0);
+}
+
+TEST_CASE("get_time() iterations are counted")
+{
+  std::vector<float> values{0, 1, 1.5f, 4};
+  std::vector<float> grid{0, 1, 3, 4};
+  asdf::MonotoneCubicSpline<float> spline(values, grid);
+  instr::reset();
+  spline.get_time(0.5f);
+  spline.get_time(2.0f);
+  spline.get_time(1.0f);  // Exact match, no iterations
+  auto snapshot = instr::snapshot();
+  CHECK(snapshot[instr::Counter::get_time_calls] == 3);
+  CHECK(snapshot[instr::Counter::get_time_iterations] >= 2);
+  CHECK(snapshot[instr::Counter::get_time_max_iterations] >= 1);
+}
+
+TEST_CASE("Counters of other threads are included")
+{
+  Spline spline(random_vertices(20, false));
+  instr::reset();
+  std::thread thread([&spline]() {
+    for (int i = 0; i < 5; ++i)
+    {
+      spline.evaluate(float(i));
+    }
+  });
+  thread.join();
+  spline.evaluate(1.0f);
+  auto snapshot = instr::snapshot();
+  CHECK(calls(snapshot, instr::Api::evaluate) == 6);
+  CHECK(snapshot[instr::Counter::s2u_calls] == 6);
+}
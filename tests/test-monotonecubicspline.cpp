@@ -0,0 +1,47 @@
+#include <catch2/catch.hpp>
+
+#include <optional>
+#include <vector>
+
+#include "monotonecubicspline.hpp"
+
+TEST_CASE("get_time() inverts evaluate()")
+{
+  std::vector<float> values{0, 1, 1.5f, 4, 4.2f};
+  std::vector<float> grid{0, 1, 3, 4, 7};
+  asdf::MonotoneCubicSpline<float> spline(values, grid);
+  std::vector<float> inputs, times;
+  for (float t = 0; t <= 7; t += 0.125f)
+  {
+    float value = spline.evaluate(t);
+    auto time = spline.get_time(value);
+    REQUIRE(time);
+    // NB: Near flat parts, the time is ill-conditioned
+    CHECK(spline.evaluate(*time) == Approx(value).margin(1e-6));
+    inputs.push_back(value);
+    times.push_back(*time);
+  }
+  std::vector<std::optional<float>> results(inputs.size());
+  spline.get_times(inputs.begin(), inputs.end(), results.begin());
+  for (size_t i = 0; i < inputs.size(); ++i)
+  {
+    CHECK(results[i] == times[i]);
+  }
+}
+
+TEST_CASE("get_time() on plateaus and out of range")
+{
+  std::vector<float> values{0, 2, 2, 3};
+  std::vector<float> grid{0, 1, 2, 3};
+  asdf::MonotoneCubicSpline<float> spline(values, grid);
+  CHECK_FALSE(spline.get_time(2));
+  CHECK(spline.get_time(-1) == 0.0f);
+  CHECK(spline.get_time(5) == 3.0f);
+}
+
+TEST_CASE("MonotoneCubicSpline rejects decreasing values")
+{
+  std::vector<float> values{0, 2, 1};
+  std::vector<float> grid{0, 1, 2};
+  CHECK_THROWS(asdf::MonotoneCubicSpline<float>(values, grid));
+}
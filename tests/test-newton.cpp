@@ -0,0 +1,42 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <utility>  // for pair
+
+#include "newton.hpp"
+
+TEST_CASE("Newton's method applies the final step")
+{
+  auto f = [](double x) { return std::make_pair(x * x - 2, 2 * x); };
+  auto result = asdf::newton(f, 1.0, 0.0, 2.0, 1e-3, 100);
+  // The residual belongs to the last evaluated point (up to "xtol" away),
+  // the final step is still applied to x
+  CHECK(std::abs(result.residual) <= 3e-3);
+  CHECK(result.x == Approx(std::sqrt(2.0)).epsilon(1e-9));
+}
+
+TEST_CASE("Newton's method stops at steps below the resolution of T")
+{
+  // The root can't be represented exactly, at the closest value
+  // the step is too small to change x
+  auto f = [](float x) {
+    return std::make_pair(static_cast<float>(x - 1.0 / 3), 1.0f);
+  };
+  auto result = asdf::newton(f, 0.9f, 0.0f, 1.0f, 1e-3f, 100);
+  CHECK(result.x == 1.0f / 3);
+  CHECK(result.calls == 2);
+}
+
+TEST_CASE("Newton's method falls back to bisection")
+{
+  // Newton's method alone would diverge
+  auto f = [](double x) {
+    return std::make_pair(std::atan(x), 1 / (1 + x * x));
+  };
+  auto result = asdf::newton(f, 5.0, -10.0, 10.0, 1e-12, 100);
+  CHECK(result.x == Approx(0.0).margin(1e-12));
+  CHECK(result.calls < 100);
+
+  auto limited = asdf::newton(f, 5.0, -10.0, 10.0, 1e-12, 3);
+  CHECK(limited.calls == 3);
+}
@@ -0,0 +1,29 @@
+#include <catch2/catch.hpp>
+
+#include <cmath>
+
+#include "gauss-kronrod.hpp"
+#include "gauss-legendre.hpp"
+
+TEST_CASE("Gauss-Legendre is exact for polynomials of degree 2N-1")
+{
+  auto f = [](double x) { return 7 * std::pow(x, 9) - 3 * x * x + 1; };
+  auto integral = [](double x) { return 0.7 * std::pow(x, 10) - x * x * x + x; };
+  CHECK(asdf::gauss_legendre<5>(f, -0.5, 2.0)
+      == Approx(integral(2.0) - integral(-0.5)).epsilon(1e-12));
+  CHECK(asdf::gauss_legendre<4>(f, -0.5, 2.0)
+      != Approx(integral(2.0) - integral(-0.5)).epsilon(1e-12));
+}
+
+TEST_CASE("Adaptive Gauss-Kronrod reaches the tolerance")
+{
+  // Integrand with a kink
+  auto f = [](double x) { return std::sqrt(std::abs(x - 0.3)); };
+  double exact = (std::pow(0.3, 1.5) + std::pow(0.7, 1.5)) * 2 / 3;
+  auto result = asdf::adaptive_gauss_kronrod(f, 0.0, 1.0, 1e-9, 100);
+  CHECK(result.error <= 1e-9);
+  CHECK(std::abs(result.value - exact) <= 1e-9);
+
+  auto single = asdf::adaptive_gauss_kronrod(f, 0.0, 1.0, 1e-9, 1);
+  CHECK(single.error > 1e-9);
+}
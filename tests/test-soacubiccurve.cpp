@@ -0,0 +1,82 @@
+#include <catch2/catch.hpp>
+
+#include <algorithm>  // for sort()
+#include <array>
+#include <random>
+#include <vector>
+
+#include "centripetalkochanekbartelsspline.hpp"
+#include "soacubiccurve.hpp"
+#include "common.hpp"
+
+using Curve = asdf::CentripetalKochanekBartelsSpline<float, V>;
+using Soa = asdf::SoaCubicCurve<float, 3>;
+
+TEST_CASE("SoaCubicCurve is the same as PiecewiseCubicCurve")
+{
+  auto data = random_vertices(50, false);
+  std::vector<V> vertices;
+  for (const auto& vertex: data)
+  {
+    vertices.push_back(std::get<V>(vertex.position));
+  }
+  Curve curve(vertices, std::vector<std::array<float, 3>>(48), false);
+  Soa soa(curve, [](const V& v, size_t d) { return (&v.x)[d]; });
+
+  // Including values outside of the grid and a partial last batch
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<float> dist(
+      curve.grid().front() - 1, curve.grid().back() + 1);
+  std::vector<float> times(203);
+  for (auto& t: times)
+  {
+    t = dist(rng);
+  }
+  times[5] = curve.grid()[7];
+  times[6] = curve.grid().back();
+  auto sorted = times;
+  std::sort(sorted.begin(), sorted.end());
+  // Many values per segment
+  std::vector<float> dense(401);
+  for (size_t i = 0; i < dense.size(); ++i)
+  {
+    dense[i] = curve.grid()[2] + (curve.grid()[6] - curve.grid()[2])
+      * float(i) / float(dense.size() - 1);
+  }
+
+  auto supported = asdf::supported_simd_level();
+  for (auto level: {asdf::SimdLevel::scalar, asdf::SimdLevel::sse
+      , asdf::SimdLevel::avx2})
+  {
+    if (level > supported)
+    {
+      continue;
+    }
+    for (const auto* values: {&times, &sorted, &dense})
+    {
+      auto n = values->size();
+      std::array<std::vector<float>, 3> positions;
+      std::array<std::vector<float>, 3> velocities;
+      for (size_t d = 0; d < 3; ++d)
+      {
+        positions[d].resize(n);
+        velocities[d].resize(n);
+      }
+      soa.evaluate_many(values->data(), n, {positions[0].data()
+          , positions[1].data(), positions[2].data()}, level);
+      soa.evaluate_velocity_many(values->data(), n, {velocities[0].data()
+          , velocities[1].data(), velocities[2].data()}, level);
+      for (size_t i = 0; i < n; ++i)
+      {
+        auto position = curve.evaluate((*values)[i]);
+        auto velocity = curve.evaluate_velocity((*values)[i]);
+        CHECK(positions[0][i] == Approx(position.x).margin(1e-5));
+        CHECK(positions[1][i] == Approx(position.y).margin(1e-5));
+        CHECK(positions[2][i] == Approx(position.z).margin(1e-5));
+        CHECK(velocities[0][i] == Approx(velocity.x).margin(1e-5));
+        CHECK(velocities[1][i] == Approx(velocity.y).margin(1e-5));
+        CHECK(velocities[2][i] == Approx(velocity.z).margin(1e-5));
+      }
+    }
+  }
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "splinecursor.hpp"
+#include "splinehandle.hpp"
+#include "common.hpp"
+
+namespace {
+
+/// Counts its destructions
+struct Tracked
+{
+  Tracked(int value, std::atomic<int>& destroyed)
+  : value(value)
+  , destroyed(destroyed)
+  {}
+
+  ~Tracked()
+  {
+    value = -1;
+    ++destroyed;
+  }
+
+  int value;
+  std::atomic<int>& destroyed;
+};
+
+}  // namespace
+
+TEST_CASE("Replaced objects are kept while they are in use")
+{
+  std::atomic<int> destroyed{0};
+  {
+    asdf::SplineHandle<Tracked> handle(
+        std::make_unique<Tracked>(1, destroyed), 2);
+    auto reader = handle.reader();
+    {
+      auto guard = reader.lock();
+      REQUIRE(guard);
+      CHECK(guard->value == 1);
+      handle.emplace(2, destroyed);
+      CHECK(guard->value == 1);
+      CHECK(destroyed == 0);
+      CHECK(handle.collect() == 1);
+    }
+    CHECK(handle.collect() == 0);
+    CHECK(destroyed == 1);
+
+    // Not in use, destroyed immediately
+    handle.emplace(3, destroyed);
+    CHECK(destroyed == 2);
+    CHECK(reader.lock()->value == 3);
+  }
+  CHECK(destroyed == 3);
+}
+
+TEST_CASE("SplineHandle has a fixed number of readers")
+{
+  asdf::SplineHandle<int> handle(nullptr, 2);
+  CHECK(handle.reader().lock().get() == nullptr);
+  auto one = handle.reader();
+  auto two = handle.reader();
+  CHECK_THROWS_AS(handle.reader(), std::runtime_error);
+  {
+    auto moved = std::move(two);
+  }
+  auto three = handle.reader();
+  CHECK_THROWS_AS(handle.reader(), std::runtime_error);
+  handle.publish(std::make_unique<int>(42));
+  CHECK(*three.lock() == 42);
+}
+
+TEST_CASE("Readers never see destroyed objects")
+{
+  std::atomic<int> destroyed{0};
+  asdf::SplineHandle<Tracked> handle(
+      std::make_unique<Tracked>(0, destroyed), 1);
+  auto reader = handle.reader();
+  std::atomic<bool> stop{false};
+  std::atomic<int> errors{0};
+  std::thread thread([&]() {
+    int previous = 0;
+    while (!stop)
+    {
+      auto guard = reader.lock();
+      int value = guard->value;
+      std::this_thread::yield();
+      // Values only increase and don't change while locked
+      if (value < previous || guard->value != value)
+      {
+        ++errors;
+      }
+      previous = value;
+    }
+  });
+  for (int i = 1; i <= 2000; ++i)
+  {
+    handle.emplace(i, destroyed);
+  }
+  stop = true;
+  thread.join();
+  CHECK(errors == 0);
+  CHECK(handle.collect() == 0);
+  CHECK(destroyed == 2000);
+}
+
+TEST_CASE("SplineCursor can be moved to a published spline")
+{
+  auto one = random_vertices(20, false, 1);
+  auto two = random_vertices(20, true, 2);
+  asdf::SplineHandle<Spline> handle(std::make_unique<Spline>(one));
+  auto reader = handle.reader();
+  Spline expected_one(one);
+  Spline expected_two(two);
+
+  auto guard = reader.lock();
+  asdf::SplineCursor<float, V> cursor(*guard);
+  CHECK(cursor.seek(2.5f) == expected_one.evaluate(2.5f));
+  guard.release();
+
+  handle.emplace(two);
+  guard = reader.lock();
+  cursor.rebind(*guard);
+  CHECK(cursor.time() == 2.5f);
+  CHECK(cursor.evaluate() == expected_two.evaluate(2.5f));
+  CHECK(cursor.advance(0.1f) == expected_two.evaluate(2.6f));
+}
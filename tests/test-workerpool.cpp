@@ -0,0 +1,44 @@
+#include <catch2/catch.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+#include "workerpool.hpp"
+
+TEST_CASE("WorkerPool processes each index exactly once")
+{
+  for (size_t threads: {1, 2, 5})
+  {
+    asdf::WorkerPool pool(threads);
+    CHECK(pool.threads() == threads);
+    for (size_t size: {0, 1, 7, 1000})
+    {
+      std::vector<int> counts(size);
+      pool.parallel_for(size, 3, [&counts](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+          ++counts[i];
+        }
+      });
+      CHECK(counts == std::vector<int>(size, 1));
+    }
+  }
+}
+
+TEST_CASE("WorkerPool re-throws exceptions")
+{
+  asdf::WorkerPool pool(3);
+  auto f = [](size_t begin, size_t) {
+    if (begin == 50)
+    {
+      throw std::out_of_range("test");
+    }
+  };
+  CHECK_THROWS_AS(pool.parallel_for(100, 10, f), std::out_of_range);
+  // The pool is still usable afterwards
+  size_t count = 0;
+  pool.parallel_for(5, 10, [&count](size_t begin, size_t end) {
+    count += end - begin;
+  });
+  CHECK(count == 5);
+}